@@ -0,0 +1,375 @@
+#pragma once
+
+#include "Parser.New.cpp"
+
+/**
+ * Results of lexing and parsing a source, shared immutably by interpreters.
+ * The tree is held by NodeSP as interpreters walk it so, but nothing changes it after parsing.
+ */
+struct Artifact {
+	SourceBufferSP code;
+	sp<const deque<Lexer::Token>> tokens;
+	NodeSP tree;  // Not parsed yet if empty
+
+	/**
+	 * Notifications are serialized once, on the first cache hit that has subscribers.
+	 */
+	const NodeValue& serializedTokens() const {
+		call_once(tokensSerialized, [this] { tokensValue = NodeValue(Lexer::to_string(*tokens), true); });
+
+		return tokensValue;
+	}
+
+	const NodeValue& serializedTree() const {
+		call_once(treeSerialized, [this] { treeValue = NodeValue(to_string(tree), true); });
+
+		return treeValue;
+	}
+
+private:
+	mutable once_flag tokensSerialized,
+					  treeSerialized;
+	mutable NodeValue tokensValue,
+					  treeValue;
+};
+
+using ArtifactSP = sp<const Artifact>;
+
+/**
+ * Parsed artifacts on disk, so unchanged scripts skip lexing and parsing across launches.
+ *
+ * File is named by hash of the code and holds a header, the code itself (compared on load, as hashes can collide)
+ * and a NodeBinary message of the tokens and the tree. Header has a stamp of the build, as grammar and lexer rules
+ * are compiled in, so a rebuilt server never reads trees of another grammar. Files are replaced atomically,
+ * concurrent launches can share a directory.
+ */
+namespace ArtifactsStorage {
+	constexpr string_view magic = "RootArtifact\n";
+	constexpr u32 formatVersion = 1;
+
+	const u64 buildStamp = std::hash<string_view>()(std::to_string(formatVersion)+" " __DATE__ " " __TIME__);
+
+	struct Header {
+		char signature[magic.size()];
+		u64 buildStamp,
+			codeSize;
+	};
+
+	filesystem::path pathOf(const filesystem::path& directory, usize hash) {
+		array<char, 16> digits;
+		char* end = to_chars(digits.begin(), digits.end(), hash, 16).ptr;
+
+		return directory/(string(digits.begin(), end)+".artifact");
+	}
+
+	/**
+	 * Tokens are encoded as arrays of position, line, column, type, value and flags.
+	 */
+	NodeArraySP encodeTokens(const deque<Lexer::Token>& tokens) {
+		auto array = SP<NodeArray>();
+
+		array->reserve(tokens.size());
+
+		for(const Lexer::Token& t : tokens) {
+			array->push_back(SP<NodeArray>(NodeArray {
+				int(t.position),
+				t.location.line,
+				t.location.column,
+				t.type,
+				t.value,
+				int(t.trivia | t.nonmergeable << 1 | t.generated << 2)
+			}));
+		}
+
+		return array;
+	}
+
+	optional<deque<Lexer::Token>> decodeTokens(const NodeArray& array) {
+		deque<Lexer::Token> tokens;
+
+		for(const NodeValue& value : array) {
+			if(value.type() != 6 || value.get<NodeArraySP>()->size() != 6) {
+				return nullopt;
+			}
+
+			const NodeArray& t = *value.get<NodeArraySP>();
+
+			if(t[0].type() != 2 || t[1].type() != 2 || t[2].type() != 2 || t[3].type() != 4 || t[4].type() != 4 || t[5].type() != 2) {
+				return nullopt;
+			}
+			int flags = t[5];
+
+			tokens.push_back({
+				.position = usize(int(t[0])),
+				.location = { t[1], t[2] },
+				.type = t[3],
+				.value = t[4],
+				.trivia = bool(flags&1),
+				.nonmergeable = bool(flags&2),
+				.generated = bool(flags&4)
+			});
+		}
+
+		return tokens;
+	}
+
+	void save(const filesystem::path& directory, usize hash, const Artifact& artifact) {
+		error_code error;
+
+		filesystem::create_directories(directory, error);
+
+		filesystem::path path = pathOf(directory, hash),
+						 temporaryPath = path;
+
+		temporaryPath += "."+to_string(getpid())+"."+to_string(gettid())+".tmp";  // Saves of the same code may run on several threads
+
+		Header header {};
+
+		header.buildStamp = buildStamp;
+		header.codeSize = artifact.code->view().size();
+
+		memcpy(header.signature, magic.data(), magic.size());
+
+		ofstream file(temporaryPath, ios::binary|ios::trunc);
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file << artifact.code->view();
+		file << NodeBinary::encode(SP<Node>(Node {
+			{"tokens", encodeTokens(*artifact.tokens)},
+			{"tree", artifact.tree}
+		}));
+		file.close();
+
+		if(!file || (filesystem::rename(temporaryPath, path, error), error)) {
+			println("[Artifacts] Can't save ", path);
+			filesystem::remove(temporaryPath, error);
+		}
+	}
+
+	/**
+	 * Reads the file mapped in memory, decoding straight from the mapping.
+	 */
+	ArtifactSP load(const filesystem::path& directory, usize hash, const SourceBufferSP& source) {
+		int FD = open(pathOf(directory, hash).c_str(), O_RDONLY|O_CLOEXEC);
+
+		if(FD < 0) {
+			return nullptr;
+		}
+
+		struct stat status;
+		void* mapping = MAP_FAILED;
+
+		if(fstat(FD, &status) == 0 && usize(status.st_size) > sizeof(Header)) {
+			mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, FD, 0);
+		}
+
+		close(FD);
+
+		if(mapping == MAP_FAILED) {
+			return nullptr;
+		}
+
+		string_view file(static_cast<const char*>(mapping), status.st_size),
+					code = source->view();
+		Header header;
+		ArtifactSP result;
+
+		memcpy(&header, file.data(), sizeof(header));
+
+		if(
+			string_view(header.signature, magic.size()) == magic &&
+			header.buildStamp == buildStamp &&
+			header.codeSize == code.size() &&
+			file.substr(sizeof(header), code.size()) == code
+		) {
+			NodeValue value = NodeBinary::decode(file.substr(sizeof(header)+code.size())),
+					  tokens,
+					  tree;
+
+			if(value.type() == 5) {
+				tokens = value.get<NodeSP>()->get("tokens", nullptr);
+				tree = value.get<NodeSP>()->get("tree", nullptr);
+			}
+
+			optional<deque<Lexer::Token>> decodedTokens = tokens.type() == 6 ? decodeTokens(*tokens.get<NodeArraySP>()) : nullopt;
+
+			if(decodedTokens && tree.type() == 5) {
+				auto artifact = SP<Artifact>();
+
+				artifact->code = source;
+				artifact->tokens = SP<const deque<Lexer::Token>>(move(*decodedTokens));
+				artifact->tree = tree.get<NodeSP>();
+				result = artifact;
+			}
+		}
+
+		munmap(mapping, status.st_size);
+
+		return result;
+	}
+};
+
+/**
+ * Artifacts by hash of their sources, so unchanged code is lexed, parsed and serialized once.
+ * Parsed artifacts are also stored on disk if a cache path is set in preferences.
+ * Cache hits notify clients the same way lexer and parser do.
+ *
+ * Misses are parsed by an editor that keeps its memo from the previous miss and updates it by the changed tokens,
+ * so a script edited and run again is reparsed incrementally. Concurrent misses (modules) parse from scratch.
+ */
+class Artifacts {
+	std::mutex mutex,
+			   editorMutex;
+	unordered_map<usize, ArtifactSP> artifacts;
+	deque<usize> order;  // Of insertion, oldest are evicted first
+	up<Parser> editor;
+	usize limit;
+
+	ArtifactSP find(usize hash, string_view code) {
+		auto it = artifacts.find(hash);
+
+		return it != artifacts.end() && it->second->code->view() == code ? it->second : nullptr;
+	}
+
+	void store(usize hash, const ArtifactSP& artifact) {
+		if(!artifacts.contains(hash)) {
+			order.push_back(hash);
+		}
+
+		artifacts[hash] = artifact;
+
+		while(artifacts.size() > limit) {
+			artifacts.erase(order.front());
+			order.pop_front();
+		}
+	}
+
+	void notify(const string& source, const string& action, const string& key, const NodeValue& value) {
+		Interface::sendToClients({
+			{"type", "notification"},
+			{"source", source},
+			{"action", "removeAll"},
+			{"moduleID", -1}
+		});
+		Interface::sendToClients({
+			{"type", "notification"},
+			{"source", source},
+			{"action", action},
+			{key, value}
+		});
+	}
+
+public:
+	Artifacts(usize limit = 32) : limit(limit) {}
+
+	/**
+	 * Returns an artifact with tokens of the code, possibly parsed already.
+	 */
+	ArtifactSP lex(const SourceBufferSP& code) {
+		usize hash = std::hash<string_view>()(code->view());
+		ArtifactSP artifact;
+
+		{
+			lock_guard lock(mutex);
+
+			artifact = find(hash, code->view());
+		}
+
+		if(!artifact && Interface::preferences.cachePath) {
+			artifact = ArtifactsStorage::load(*Interface::preferences.cachePath, hash, code);
+		}
+
+		if(artifact) {
+			{
+				lock_guard lock(mutex);
+
+				store(hash, artifact);
+			}
+
+			if(Interface::subscribed(Interface::Source::Lexer)) {  // Outside of the cache lock, as clients may be slow
+				notify("lexer", "tokenized", "tokens", artifact->serializedTokens());
+			}
+
+			return artifact;
+		}
+
+		auto lexedArtifact = SP<Artifact>();
+
+		lexedArtifact->code = code;
+		lexedArtifact->tokens = SP<const deque<Lexer::Token>>(Lexer(code->view()).tokenize());
+
+		lock_guard lock(mutex);
+
+		store(hash, lexedArtifact);
+
+		return lexedArtifact;
+	}
+
+	/**
+	 * Returns a parsed artifact with the same code and tokens.
+	 */
+	ArtifactSP parse(const ArtifactSP& artifact) {
+		usize hash = std::hash<string_view>()(artifact->code->view());
+
+		ArtifactSP cachedArtifact = artifact;
+
+		if(!cachedArtifact->tree) {
+			lock_guard lock(mutex);
+
+			cachedArtifact = find(hash, artifact->code->view());
+		}
+
+		if(cachedArtifact && cachedArtifact->tree) {
+			if(Interface::subscribed(Interface::Source::Parser)) {  // Outside of the cache lock, as clients may be slow
+				notify("parser", "parsed", "tree", cachedArtifact->serializedTree());
+			}
+
+			return cachedArtifact;
+		}
+
+		auto parsedArtifact = SP<Artifact>();
+
+		parsedArtifact->code = artifact->code;
+		parsedArtifact->tokens = artifact->tokens;
+
+		if(unique_lock editorLock(editorMutex, try_to_lock); editorLock) {
+			if(editor) {
+				editor->update(*artifact->tokens);
+			} else {
+				editor = make_unique<Parser>(*artifact->tokens);
+			}
+
+			parsedArtifact->tree = editor->parse();
+		} else {
+			parsedArtifact->tree = Parser(*artifact->tokens).parse();
+		}
+
+		if(Interface::preferences.cachePath) {
+			ArtifactsStorage::save(*Interface::preferences.cachePath, hash, *parsedArtifact);
+		}
+
+		lock_guard lock(mutex);
+
+		store(hash, parsedArtifact);
+
+		return parsedArtifact;
+	}
+
+	ArtifactSP get(const SourceBufferSP& code) {
+		return parse(lex(code));
+	}
+
+	/**
+	 * Notifies clients of tokens and tree of an artifact, as lexing and parsing would, e.g. after muted loads.
+	 */
+	void notify(const ArtifactSP& artifact) {
+		if(Interface::subscribed(Interface::Source::Lexer)) {
+			notify("lexer", "tokenized", "tokens", artifact->serializedTokens());
+		}
+		if(artifact->tree && Interface::subscribed(Interface::Source::Parser)) {
+			notify("parser", "parsed", "tree", artifact->serializedTree());
+		}
+	}
+};
+
+static Artifacts sharedArtifacts;
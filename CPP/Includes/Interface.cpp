@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Node.cpp"
+#include "NodeBinary.cpp"
 #include "Socket.cpp"
 
 namespace Interface {
@@ -17,17 +18,23 @@ namespace Interface {
 		optional<filesystem::path> socketPath;
 		unordered_set<string> tokens;
 
+		optional<filesystem::path> cachePath;
+
 		usize callStackSize = 128,
 			  reportsLevel = 3,
-			  metaprogrammingLevel = 3;
-		bool preciseArithmetics = false;
+			  metaprogrammingLevel = 3,
+			  threadPoolSize = 0,
+			  socketThreadsCount = 2;
+		bool preciseArithmetics = false,
+			 optimizations = true;
 	} preferences;
 
 	void printUsage() {
 		cout << "Usage:\n"
 			 << "    RootServer (--interpret [PATH] | --dashboard)\n"
-			 << "               [--socket [PATH]] [--token [TOKEN]]\n"
-			 << "               [--callStackSize NUMBER] [--reportsLevel NUMBER] [--metaprogrammingLevel NUMBER] [--preciseArithmetics]\n"
+			 << "               [--socket [PATH]] [--token [TOKEN]] [--socketThreadsCount NUMBER]\n"
+			 << "               [--callStackSize NUMBER] [--reportsLevel NUMBER] [--metaprogrammingLevel NUMBER] [--preciseArithmetics] [--noOptimizations]\n"
+			 << "               [--threadPoolSize NUMBER] [--cachePath [PATH]]\n"
 			 << "               [--arguments [ARGUMENT]...]\n\n"
 
 			 << "Modes:\n"
@@ -37,13 +44,18 @@ namespace Interface {
 			 << "Debugging:\n"
 			 << "    (-s | --socket) [PATH]                   Path of the socket (default - \"/tmp/RootServer.sock\" if enabled; always enabled for dashboard)\n"
 			 << "    (-t | --token) (DIRECTION)[TOKEN]        Security token (at least one of \"<\" or \"=\" direction is required if socket enabled,\n"
-			 << "                                             either as argument or standard input): < - input, > - output, = - universal\n\n"
+			 << "                                             either as argument or standard input): < - input, > - output, = - universal\n"
+			 << "    (-sts | --socketThreadsCount) NUMBER     Dashboard socket I/O threads (default - 2): 0 - thread per connection\n\n"
 
 			 << "Execution:\n"
 			 << "    (-css | --callStackSize) NUMBER          Call stack size (default - 128)\n"
 			 << "    (-rl | --reportsLevel) NUMBER            Reports level (default - 2): 0 - information, 1 - warning, 2 - error\n"
 			 << "    (-ml | --metaprogrammingLevel) NUMBER    Metaprogramming level (default - 2): 0 - disabled, 1 - read, 2 - write\n"
 			 << "    (-pa | --preciseArithmetics)             Precise string-based arithmetic (default - disabled)\n"
+			 << "    (-no | --noOptimizations)                Interpret the tree as parsed, without constant folding (default - enabled)\n"
+			 << "    (-tps | --threadPoolSize) NUMBER         Background threads count (default - 0): 0 - hardware concurrency\n"
+			 << "    (-cp | --cachePath) [PATH]               Directory of lexed and parsed scripts, reused while they are unchanged\n"
+			 << "                                             (default - \"/tmp/RootServer.cache\" if enabled)\n"
 			 << "    (-a | --arguments) [ARGUMENT]...         Script arguments\n\n"
 
 			 << "Help:\n"
@@ -69,6 +81,10 @@ namespace Interface {
 		if(preferences.socketPath) {
 			cout << "          Socket Mode: " << (preferences.mode == Preferences::Mode::Dashboard ? "Server" : "Client") << endl;
 			cout << "          Socket Path: " << *preferences.socketPath << endl;
+
+			if(preferences.mode == Preferences::Mode::Dashboard) {
+				cout << " Socket Threads Count: " << preferences.socketThreadsCount << endl;
+			}
 		}
 
 		cout << "               Tokens: " << join(preferences.tokens, ", ") << endl;  // TODO: Should be hidden
@@ -76,6 +92,12 @@ namespace Interface {
 		cout << "        Reports Level: " << preferences.reportsLevel << endl;
 		cout << "Metaprogramming Level: " << preferences.metaprogrammingLevel << endl;
 		cout << "  Precise Arithmetics: " << (preferences.preciseArithmetics ? "Enabled" : "Disabled") << endl;
+		cout << "        Optimizations: " << (preferences.optimizations ? "Enabled" : "Disabled") << endl;
+		cout << "     Thread Pool Size: " << (preferences.threadPoolSize ?: thread::hardware_concurrency()) << endl;
+
+		if(preferences.cachePath) {
+			cout << "           Cache Path: " << *preferences.cachePath << endl;
+		}
 	}
 
 	bool isPositiveInteger(const string& s) {
@@ -140,10 +162,14 @@ namespace Interface {
 			{"-d", "--dashboard"},
 			{"-s", "--socket"},
 			{"-t", "--token"},
+			{"-sts", "--socketThreadsCount"},
 			{"-css", "--callStackSize"},
 			{"-rl", "--reportsLevel"},
 			{"-ml", "--metaprogrammingLevel"},
 			{"-pa", "--preciseArithmetics"},
+			{"-no", "--noOptimizations"},
+			{"-tps", "--threadPoolSize"},
+			{"-cp", "--cachePath"},
 			{"-a", "--arguments"},
 			{"-h", "--help"}
 		};
@@ -187,6 +213,15 @@ namespace Interface {
 
 				return true;
 			}},
+			{"--socketThreadsCount", [&](int& i) {
+				if(i+1 >= argc || !isPositiveInteger(argv[i+1])) {
+					return false;
+				}
+
+				preferences.socketThreadsCount = stoi(argv[++i]);
+
+				return true;
+			}},
 			{"--callStackSize", [&](int& i) {
 				if(i+1 >= argc || !isPositiveInteger(argv[i+1])) {
 					return false;
@@ -219,6 +254,29 @@ namespace Interface {
 
 				return true;
 			}},
+			{"--noOptimizations", [&](int&) {
+				preferences.optimizations = false;
+
+				return true;
+			}},
+			{"--threadPoolSize", [&](int& i) {
+				if(i+1 >= argc || !isPositiveInteger(argv[i+1])) {
+					return false;
+				}
+
+				preferences.threadPoolSize = stoi(argv[++i]);
+
+				return true;
+			}},
+			{"--cachePath", [&](int& i) {
+				if(i+1 < argc && argv[i+1][0] != '-') {
+					preferences.cachePath = argv[++i];
+				} else {
+					preferences.cachePath = "/tmp/RootServer.cache";
+				}
+
+				return true;
+			}},
 			{"--arguments", [&](int& i) {
 				i++;
 
@@ -305,10 +363,53 @@ namespace Interface {
 
 	// ----------------------------------------------------------------
 
-	void send(const string& input) {
+	atomic<bool> binaryEncoding = false;  // Acknowledged by the server for the current connection
+
+	/**
+	 * Messages are received in either encoding, regardless of negotiation.
+	 */
+	NodeValue parse(string_view message) {
+		return NodeBinary::is(message) ? NodeBinary::decode(message) : NodeParser(message).parse();
+	}
+
+	constexpr usize outboxHighWaterMark = 16*1024*1024;  // Bytes
+
+	/**
+	 * Waits while messages queued for the server are above the high-water mark, so producers can't outpace it
+	 * without bound. Outbox is drained by the client's reactor and by other senders, or dropped on disconnection.
+	 */
+	void throttle() {
+		while(sharedClient->isRunning() && sharedClient->getOutboxSize() > outboxHighWaterMark) {
+			this_thread::sleep_for(1ms);
+		}
+	}
+
+	void send(string input) {
 		if(sharedClient) {
-			sharedClient->send(input);
+			throttle();
+			sharedClient->send(move(input));
+		}
+	}
+
+	/**
+	 * Node is serialized in one pass straight into the message that is queued for sending.
+	 */
+	void send(const Node& node) {
+		if(!sharedClient) {
+			return;
+		}
+
+		throttle();
+
+		string message;
+
+		if(binaryEncoding) {
+			message = NodeBinary::encode(node);
+		} else {
+			write_json(message, node);
 		}
+
+		sharedClient->send(move(message));
 	}
 
 	void sendToClients(Node node) {
@@ -322,4 +423,127 @@ namespace Interface {
 
 		send(node);
 	}
+
+	// ----------------------------------------------------------------
+
+	/**
+	 * Clients subscribe to sources of notifications with a detail level, declared in heartbeats.
+	 * The server announces highest levels over all clients to the producers, so they skip building
+	 * and serializing notifications that nobody receives.
+	 */
+	enum class Source : u8 {
+		Lexer,
+		Parser,
+		Interpreter
+	};
+
+	enum class Detail : u8 {
+		None,
+		Results,  // Final results and reports
+		Progress  // Intermediate states, such as partial trees and rollbacks
+	};
+
+	using Subscriptions = array<Detail, 3>;  // [Source : Detail]
+
+	const array<string, 3> sourcesNames = { "lexer", "parser", "interpreter" },
+						   detailsNames = { "none", "results", "progress" };
+
+	const Subscriptions allSubscriptions = { Detail::Progress, Detail::Progress, Detail::Progress };
+
+	array<atomic<Detail>, 3> subscriptions = { Detail::Progress, Detail::Progress, Detail::Progress };  // Everything until the server announces otherwise, as servers before subscriptions never do
+
+	Subscriptions parseSubscriptions(const Node& node) {
+		Subscriptions result = {};
+
+		for(usize i = 0; i < sourcesNames.size(); i++) {
+			string detail = node.get<string>(sourcesNames[i]);
+			auto it = find(detailsNames.begin(), detailsNames.end(), detail);
+
+			if(it != detailsNames.end()) {
+				result[i] = Detail(it-detailsNames.begin());
+			}
+		}
+
+		return result;
+	}
+
+	Node subscriptionsNode(const Subscriptions& subscriptions) {
+		Node node;
+
+		for(usize i = 0; i < sourcesNames.size(); i++) {
+			node[sourcesNames[i]] = detailsNames[usize(subscriptions[i])];
+		}
+
+		return node;
+	}
+
+	void setSubscriptions(const Subscriptions& subscriptions_) {
+		for(usize i = 0; i < subscriptions.size(); i++) {
+			subscriptions[i] = subscriptions_[i];
+		}
+	}
+
+	thread_local bool muted = false;  // See Mute
+
+	/**
+	 * Suppresses notifications of the thread while alive, for work whose results are notified of at once later.
+	 */
+	struct Mute {
+		bool previous = muted;
+
+		Mute() {
+			muted = true;
+		}
+
+		~Mute() {
+			muted = previous;
+		}
+	};
+
+	bool subscribed(Source source, Detail detail = Detail::Results) {
+		return sharedClient && !muted && subscriptions[usize(source)] >= detail;
+	}
+
+	/**
+	 * Limits a high-frequency notification to one per window. Notifications in between are merged into a pending one,
+	 * which is sent by a later call after the window or by flush() (before notifications that depend on it).
+	 * Belongs to a single producer.
+	 */
+	class Coalescer {
+		using Merge = function<void(Node& pending, const Node& node)>;
+
+		chrono::steady_clock::duration window;
+		chrono::steady_clock::time_point sentAt;
+		optional<Node> pending;
+
+	public:
+		Coalescer(chrono::milliseconds window = 100ms) : window(window) {}
+
+		/**
+		 * Without a merge function, the latest notification replaces the pending one.
+		 */
+		void send(Node node, const Merge& merge = nullptr) {
+			if(pending && merge) {
+				merge(*pending, node);
+			} else {
+				pending = move(node);
+			}
+
+			if(chrono::steady_clock::now()-sentAt >= window) {
+				flush();
+			}
+		}
+
+		void flush() {
+			if(pending) {
+				sendToClients(move(*pending));
+				pending.reset();
+				sentAt = chrono::steady_clock::now();
+			}
+		}
+
+		void discard() {
+			pending.reset();
+		}
+	};
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Parser.New.cpp"
+#include "ThreadPool.cpp"
 
 struct Interpreter;
 
@@ -17,33 +18,33 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		   scopes = 0,
 		   controlTransfers = 0;
 	} inheritedContext;
-	string_view code;
-	deque<Token> tokens;
+	SourceBufferSP code;  // Owned by interpreters as long as their tokens and tree
+	sp<const deque<Token>> tokens;  // Shared with parent and child interpreters
 	NodeSP tree;
 	int position = 0;
 
 	Interpreter() {}
 
-	Interpreter(string_view code,
-				deque<Token> tokens,
+	Interpreter(SourceBufferSP code,
+				sp<const deque<Token>> tokens,
 				NodeSP tree) : code(code),
 							   tokens(tokens),
 							   tree(tree) {}
 
 	Interpreter(InterpreterSP parent,
 				InheritedContext IC,
-				string_view code,
-				deque<Token> tokens,
+				SourceBufferSP code,
+				sp<const deque<Token>> tokens,
 				NodeSP tree) : inheritedContext(IC),
 							   parent(parent),
 							   code(code),
 							   tokens(tokens),
 							   tree(tree)
 	{
-		if(inheritedContext.composites == 1)		_composites = parent->_composites;
-	//	if(inheritedContext.calls == 1)				_calls = parent->_calls;
-		if(inheritedContext.scopes == 1)			_scopes = parent->_scopes;
-		if(inheritedContext.controlTransfers == 1)	_controlTransfers = parent->_controlTransfers;
+		if(inheritedContext.composites == 1)		_composites = parent->composites();
+		if(inheritedContext.calls == 1)				_calls = parent->calls();
+		if(inheritedContext.scopes == 1)			_scopes = parent->scopes();
+		if(inheritedContext.controlTransfers == 1)	_controlTransfers = parent->controlTransfers();
 	}
 
 	// ----------------------------------------------------------------
@@ -65,6 +66,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 	struct FunctionType;
 	struct InoutType;
 	struct VariadicType;
+	struct PromiseType;
 
 	// ----------------------------------------------------------------
 
@@ -85,6 +87,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 	using FunctionTypeSP = sp<FunctionType>;
 	using InoutTypeSP = sp<InoutType>;
 	using VariadicTypeSP = sp<VariadicType>;
+	using PromiseTypeSP = sp<PromiseType>;
 
 	// ----------------------------------------------------------------
 
@@ -106,7 +109,8 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 		Function,
 		Inout,
-		Variadic
+		Variadic,
+		Promise
 	};
 
 	enum class PredefinedTypeID : u8 {
@@ -156,6 +160,8 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 	deque<CompositeTypeSP> _composites;
 	deque<CompositeTypeSP> _scopes;
+	deque<PromiseTypeSP> _promises;
+	recursive_mutex _heapMutex;
 
 	deque<CompositeTypeSP>& composites() {
 		return inheritedContext.composites == 2 && parent
@@ -163,7 +169,32 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 			 : _composites;
 	}
 
+	/**
+	 * Promises of async expressions that may still be evaluated on the thread pool using the shared composites.
+	 */
+	deque<PromiseTypeSP>& promises() {
+		return inheritedContext.composites == 2 && parent
+			 ? parent->promises()
+			 : _promises;
+	}
+
+	/**
+	 * Guards composites registry, their members, hierarchies and retentions, which are shared by interpreters
+	 * that inherit composites by reference and may run on different threads.
+	 *
+	 * The lock is single (of the root interpreter) rather than per composite, as lookups walk scope chains and
+	 * inheritance in no particular order. The price is that identifier resolution and member access of concurrent
+	 * async expressions are serialized, only work between them runs in parallel (see Tests/Async).
+	 */
+	recursive_mutex& heapMutex() {
+		return inheritedContext.composites == 2 && parent
+			 ? parent->heapMutex()
+			 : _heapMutex;
+	}
+
 	CompositeTypeSP getComposite(optional<int> ID) {
+		lock_guard lock(heapMutex());
+
 		return ID && *ID < composites().size() ? composites().at(*ID) : nullptr;
 	}
 
@@ -224,6 +255,104 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 	// ----------------------------------------------------------------
 
+	struct Call {
+		CompositeTypeSP function,
+						scope;  // Locals
+		int position = 0;
+	};
+
+	struct CallStack {
+		vector<Call> frames;  // Preallocated up to the call stack size, only first `size` are in use
+		usize size = 0;
+	};
+
+	CallStack _calls;
+
+	inline static function<void(const Interpreter&, const CallStack&)> callsSampler;  // Profiling hook, invoked on every n-th call
+	inline static usize callsSamplingInterval = 1024;
+	usize callsCounter = 0;
+
+	CallStack& calls() {
+		return inheritedContext.calls == 2 && parent
+			 ? parent->calls()
+			 : _calls;
+	}
+
+	/**
+	 * Exceeding the call stack size is a regular (catchable) error at the language level,
+	 * so it's thrown as an exception and turned into a control transfer by executeNode().
+	 */
+	void addCall(const CompositeTypeSP& function, const CompositeTypeSP& scope = nullptr) {
+		CallStack& CS = calls();
+		usize limit = Interface::preferences.callStackSize;
+
+		if(CS.size >= limit) {
+			throw invalid_argument("Maximum call stack size exceeded.\n"+getCallsString());
+		}
+		if(CS.frames.size() < limit) {
+			CS.frames.resize(limit);
+		}
+
+		Call& call = CS.frames[CS.size++];
+
+		call.function = function;
+		call.scope = scope;
+		call.position = position;
+
+		if(callsSampler && ++callsCounter%callsSamplingInterval == 0) {
+			callsSampler(*this, CS);
+		}
+	}
+
+	inline static thread_local uintptr_t nodesStackBase = 0;  // Stack address of the outermost executeNode() on the thread
+
+	/**
+	 * Nodes are executed recursively, so deep scripts (recursion included, as calls are made by nodes) would overflow
+	 * the native stack before the call stack size is reached. Frames of rules differ by an order of magnitude between
+	 * optimization levels, so instead of depth, usage of the stack is limited to half of it (of a thread, which is
+	 * the default size or the soft limit, as for the main thread).
+	 */
+	static usize nodesStackLimit() {
+		static const usize limit = [] {
+			rlimit RL;
+
+			return (getrlimit(RLIMIT_STACK, &RL) == 0 && RL.rlim_cur != RLIM_INFINITY ? RL.rlim_cur : 2*1024*1024)/2;
+		}();
+
+		return limit;
+	}
+
+	void removeCall() {
+		CallStack& CS = calls();
+
+		CS.frames[--CS.size] = Call();  // Release retained composites
+	}
+
+	string getCallsString() {
+		CallStack& CS = calls();
+		string result;
+
+		for(usize i = CS.size, j = 0; i > 0 && j < 8; i--, j++) {
+			const Call& call = CS.frames[i-1];
+
+			if(j > 0) {
+				result += "\n";
+			}
+
+			result += std::to_string(j)+": "+(call.function ? call.function->getTitle() : "nil");
+
+			if(tokens && usize(call.position) < tokens->size()) {
+				Location location = (*tokens)[call.position].location;
+
+				result += ":"+std::to_string(location.line+1)+":"+std::to_string(location.column+1);
+			}
+		}
+
+		return result;
+	}
+
+	// ----------------------------------------------------------------
+
 	struct AccessPath {
 		variant<string, vector<TypeSP>> key;
 		bool internal = false;
@@ -264,14 +393,121 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 	// ----------------------------------------------------------------
 
+	/**
+	 * Structural identity of an interned type: its ID, its parts and any other distinguishing bits.
+	 *
+	 * Parts are compared by address, so keys of structurally equal types match only when their parts are interned too.
+	 * Addresses are never reused while a type is alive, as the type itself retains its parts.
+	 */
+	struct TypeKey {
+		TypeID ID;
+		vector<const Type*> parts;
+		usize extra;
+
+		TypeKey(TypeID ID, const vector<TypeSP>& types, usize extra = 0) : ID(ID), extra(extra) {
+			parts.reserve(types.size());
+
+			for(const TypeSP& type : types) {
+				parts.push_back(type.get());
+			}
+		}
+
+		bool operator==(const TypeKey&) const = default;
+	};
+
+	struct TypeKeyHasher {
+		usize operator()(const TypeKey& key) const {
+			usize result = static_cast<usize>(key.ID)*31+key.extra;
+
+			for(const Type* part : key.parts) {
+				result = result*31^hash<const Type*>()(part);
+			}
+
+			return result;
+		}
+	};
+
+	inline static unordered_map<TypeKey, wp<Type>, TypeKeyHasher> internedTypes;
+	inline static usize internedTypesSweepSize = 256;
+	inline static mutex internedTypesMutex;
+
+	/**
+	 * Returns an alive instance structurally equal to the key or creates a new one.
+	 *
+	 * Instances are referenced weakly, so types no one uses anymore are released
+	 * and their entries are swept when the table grows.
+	 */
+	template <typename T, typename... Args>
+	static sp<T> internType(const TypeKey& key, Args&&... arguments) {
+		lock_guard lock(internedTypesMutex);
+		wp<Type>& entry = internedTypes[key];
+
+		if(TypeSP type = entry.lock()) {
+			return static_pointer_cast<T>(type);
+		}
+
+		auto type = SP<T>(forward<Args>(arguments)...);
+
+		type->interned = true;
+		entry = type;
+
+		if(internedTypes.size() > internedTypesSweepSize) {
+			erase_if(internedTypes, [](auto& v) { return v.second.expired(); });
+
+			internedTypesSweepSize = max<usize>(256, internedTypes.size()*2);
+		}
+
+		return type;
+	}
+
+	struct ConformanceKey {
+		const void* accepting;
+		const void* accepted;
+
+		bool operator==(const ConformanceKey&) const = default;
+	};
+
+	struct ConformanceKeyHasher {
+		usize operator()(const ConformanceKey& key) const {
+			return hash<const void*>()(key.accepting)*31^hash<const void*>()(key.accepted);
+		}
+	};
+
+	struct Conformance {
+		wp<Type> accepting,
+				 accepted;
+		bool byKind,  // Accepted type is identified by its kind rather than by itself
+			 result;
+	};
+
+	inline static unordered_map<ConformanceKey, Conformance, ConformanceKeyHasher> conformances;
+	inline static usize conformancesSweepSize = 1024,
+						conformancesLimit = 64*1024;  // Table is cleared if live pairs fill the half of it
+	inline static mutex conformancesMutex;
+
+	/**
+	 * Should be called whenever conformance of existing types may change (e.g. composites inheritance).
+	 */
+	static void invalidateConformances() {
+		lock_guard lock(conformancesMutex);
+
+		conformances.clear();
+	}
+
+	// ----------------------------------------------------------------
+
 	struct Type : enable_shared_from_this<Type> {
 		const TypeID ID;
 		const bool concrete;
+		bool interned = false;	// Shared immutable instance
+		bool normal = false;	// Interned type is its own normalized form
+		TypeSP normalizedType;	// Cached normalized form of an interned type
 
 		Type(TypeID ID = TypeID::Undefined, bool concrete = false) : ID(ID), concrete(concrete) { /*cout << "Type created\n";*/ }
 		virtual ~Type() { /*cout << "Type destroyed\n";*/ }
 
 		virtual bool acceptsA(const TypeSP& type) { return false; }
+		virtual const void* conformanceKey() const { return interned || ID == TypeID::Predefined || ID == TypeID::Composite ? this : nullptr; }  // Identity of a type whose conformance is stable
 		virtual bool conformsTo(const TypeSP& type) { return type->acceptsA(shared_from_this()); }
 		virtual TypeSP normalized() { return shared_from_this(); }
 		virtual string toString() const { return string(); }  // User-friendly representation
@@ -336,6 +572,84 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		static bool acceptsAConcrete(const TypeSP& left, const TypeSP& right) {
 			return left && right && right->concrete && left->acceptsA(right);
 		}
+
+		/**
+		 * Memoizes acceptance between stable types (interned, predefined, composite or primitive by its kind).
+		 * Entries remember both sides weakly, so results are never taken for another type allocated at the same address.
+		 */
+		template <typename F>
+		bool cachedAcceptance(const TypeSP& type, F accepts) {
+			const void* typeKey = type->conformanceKey();
+
+			if(!typeKey || (!interned && ID != TypeID::Composite)) {
+				return accepts();
+			}
+
+			ConformanceKey key = { this, typeKey };
+
+			{
+				lock_guard lock(conformancesMutex);
+
+				if(auto it = conformances.find(key); it != conformances.end()) {
+					Conformance& conformance = it->second;
+
+					if(!conformance.accepting.expired() && (conformance.byKind || !conformance.accepted.expired())) {
+						return conformance.result;
+					}
+				}
+			}
+
+			bool result = accepts();
+			lock_guard lock(conformancesMutex);
+
+			bool byKind = typeKey != type.get();
+
+			conformances[key] = { weak_from_this(), byKind ? wp<Type>() : wp<Type>(type), byKind, result };
+
+			if(conformances.size() > conformancesSweepSize) {
+				erase_if(conformances, [](auto& v) { return v.second.accepting.expired() || (!v.second.byKind && v.second.accepted.expired()); });
+
+				if(conformances.size() > conformancesLimit/2) {
+					conformances.clear();
+				}
+
+				conformancesSweepSize = max<usize>(1024, conformances.size()*2);
+			}
+
+			return result;
+		}
+
+		/**
+		 * Interned types are immutable, so their normalization is performed only once.
+		 */
+		template <typename F>
+		TypeSP cachedNormalized(F normalize) {
+			if(!interned) {
+				return normalize();
+			}
+
+			{
+				lock_guard lock(internedTypesMutex);
+
+				if(normal) {
+					return shared_from_this();
+				}
+				if(normalizedType) {
+					return normalizedType;
+				}
+			}
+
+			TypeSP type = normalize();
+			lock_guard lock(internedTypesMutex);
+
+			if(type.get() == this) {
+				normal = true;
+			} else {
+				normalizedType = type;
+			}
+
+			return type;
+		}
 	};
 
 	static string to_string(const TypeSP& type, bool raw = false) {
@@ -350,8 +664,12 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		ParenthesizedType(TypeSP type) : Type(TypeID::Parenthesized), innerType(move(type)) { cout << "(" << innerType->toString() << ") type created\n"; }
 		~ParenthesizedType() { cout << "(" << innerType->toString() << ") type destroyed\n"; }
 
+		static ParenthesizedTypeSP get(const TypeSP& innerType) {
+			return internType<ParenthesizedType>({ TypeID::Parenthesized, { innerType } }, innerType);
+		}
+
 		bool acceptsA(const TypeSP& type) override {
-			return innerType->acceptsA(type);
+			return type.get() == this || innerType->acceptsA(type);
 		}
 
 		TypeSP normalized() override {
@@ -369,20 +687,29 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		NillableType(TypeSP type) : Type(TypeID::Nillable), innerType(move(type)) { cout << innerType->toString() << "? type created\n"; }
 		~NillableType() { cout << innerType->toString() << "? type destroyed\n"; }
 
+		static NillableTypeSP get(const TypeSP& innerType) {
+			return internType<NillableType>({ TypeID::Nillable, { innerType } }, innerType);
+		}
+
 		bool acceptsA(const TypeSP& type) override {
-			return PredefinedEVoidTypeSP->acceptsA(type) ||
-				   type->ID == TypeID::Nillable && innerType->acceptsA(static_pointer_cast<NillableType>(type)->innerType) ||
-				   innerType->acceptsA(type);
+			return cachedAcceptance(type, [&] {
+				return type.get() == this ||
+					   PredefinedEVoidTypeSP->acceptsA(type) ||
+					   (type->ID == TypeID::Nillable && innerType->acceptsA(static_pointer_cast<NillableType>(type)->innerType)) ||
+					   innerType->acceptsA(type);
+			});
 		}
 
 		TypeSP normalized() override {
-			auto normInnerType = innerType->normalized();
+			return cachedNormalized([this] {
+				auto normInnerType = innerType->normalized();
 
-			if(normInnerType->ID == TypeID::Nillable) {
-				return normInnerType;
-			}
+				if(normInnerType->ID == TypeID::Nillable) {
+					return normInnerType;
+				}
 
-			return SP<NillableType>(normInnerType);
+				return static_pointer_cast<Type>(get(normInnerType));
+			});
 		}
 
 		string toString() const override {
@@ -396,20 +723,29 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		DefaultType(TypeSP type) : Type(TypeID::Default), innerType(move(type)) { cout << innerType->toString() << "? type created\n"; }
 		~DefaultType() { cout << innerType->toString() << "! type destroyed\n"; }
 
+		static DefaultTypeSP get(const TypeSP& innerType) {
+			return internType<DefaultType>({ TypeID::Default, { innerType } }, innerType);
+		}
+
 		bool acceptsA(const TypeSP& type) override {
-			return PredefinedEVoidTypeSP->acceptsA(type) ||
-				   type->ID == TypeID::Default && innerType->acceptsA(static_pointer_cast<DefaultType>(type)->innerType) ||
-				   innerType->acceptsA(type);
+			return cachedAcceptance(type, [&] {
+				return type.get() == this ||
+					   PredefinedEVoidTypeSP->acceptsA(type) ||
+					   (type->ID == TypeID::Default && innerType->acceptsA(static_pointer_cast<DefaultType>(type)->innerType)) ||
+					   innerType->acceptsA(type);
+			});
 		}
 
 		TypeSP normalized() override {
-			auto normInnerType = innerType->normalized();
+			return cachedNormalized([this] {
+				auto normInnerType = innerType->normalized();
 
-			if(normInnerType->ID == TypeID::Default) {
-				return normInnerType;
-			}
+				if(normInnerType->ID == TypeID::Default) {
+					return normInnerType;
+				}
 
-			return SP<DefaultType>(normInnerType);
+				return static_pointer_cast<Type>(get(normInnerType));
+			});
 		}
 
 		string toString() const override {
@@ -422,36 +758,48 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 		UnionType(const vector<TypeSP>& alternatives) : Type(TypeID::Union), alternatives(alternatives) {}
 
+		static UnionTypeSP get(const vector<TypeSP>& alternatives) {
+			return internType<UnionType>({ TypeID::Union, alternatives }, alternatives);
+		}
+
 		bool acceptsA(const TypeSP& type) override {
-			for(const TypeSP& alt : alternatives) {
-				if(alt->acceptsA(type)) {
+			return cachedAcceptance(type, [&] {
+				if(type.get() == this) {
 					return true;
 				}
-			}
 
-			return false;
+				for(const TypeSP& alt : alternatives) {
+					if(alt->acceptsA(type)) {
+						return true;
+					}
+				}
+
+				return false;
+			});
 		}
 
 		TypeSP normalized() override {
-			vector<TypeSP> normAlts;
+			return cachedNormalized([this] {
+				vector<TypeSP> normAlts;
 
-			for(const TypeSP& alt : alternatives) {
-				TypeSP normAlt = alt->normalized();
+				for(const TypeSP& alt : alternatives) {
+					TypeSP normAlt = alt->normalized();
 
-				if(normAlt->ID == TypeID::Union) {
-					auto normUnionAlt = static_pointer_cast<UnionType>(normAlt);
+					if(normAlt->ID == TypeID::Union) {
+						auto normUnionAlt = static_pointer_cast<UnionType>(normAlt);
 
-					normAlts.insert(normAlts.end(), normUnionAlt->alternatives.begin(), normUnionAlt->alternatives.end());
-				} else {
-					normAlts.push_back(normAlt);
+						normAlts.insert(normAlts.end(), normUnionAlt->alternatives.begin(), normUnionAlt->alternatives.end());
+					} else {
+						normAlts.push_back(normAlt);
+					}
 				}
-			}
 
-			if(normAlts.size() == 1) {
-				return normAlts[0];
-			}
+				if(normAlts.size() == 1) {
+					return normAlts[0];
+				}
 
-			return SP<UnionType>(normAlts);
+				return static_pointer_cast<Type>(get(normAlts));
+			});
 		}
 
 		string toString() const override {
@@ -474,36 +822,48 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 		IntersectionType(const vector<TypeSP>& alternatives) : Type(TypeID::Intersection), alternatives(alternatives) {}
 
+		static IntersectionTypeSP get(const vector<TypeSP>& alternatives) {
+			return internType<IntersectionType>({ TypeID::Intersection, alternatives }, alternatives);
+		}
+
 		bool acceptsA(const TypeSP& type) override {
-			for(const TypeSP& alt : alternatives) {
-				if(!alt->acceptsA(type)) {
-					return false;
+			return cachedAcceptance(type, [&] {
+				if(type.get() == this) {
+					return true;
 				}
-			}
 
-			return true;
+				for(const TypeSP& alt : alternatives) {
+					if(!alt->acceptsA(type)) {
+						return false;
+					}
+				}
+
+				return true;
+			});
 		}
 
 		TypeSP normalized() override {
-			vector<TypeSP> normAlts;
+			return cachedNormalized([this] {
+				vector<TypeSP> normAlts;
 
-			for(const TypeSP& alt : alternatives) {
-				TypeSP normAlt = alt->normalized();
+				for(const TypeSP& alt : alternatives) {
+					TypeSP normAlt = alt->normalized();
 
-				if(normAlt->ID == TypeID::Intersection) {
-					auto normUnionAlt = static_pointer_cast<IntersectionType>(normAlt);
+					if(normAlt->ID == TypeID::Intersection) {
+						auto normUnionAlt = static_pointer_cast<IntersectionType>(normAlt);
 
-					normAlts.insert(normAlts.end(), normUnionAlt->alternatives.begin(), normUnionAlt->alternatives.end());
-				} else {
-					normAlts.push_back(normAlt);
+						normAlts.insert(normAlts.end(), normUnionAlt->alternatives.begin(), normUnionAlt->alternatives.end());
+					} else {
+						normAlts.push_back(normAlt);
+					}
 				}
-			}
 
-			if(normAlts.size() == 1) {
-				return normAlts[0];
-			}
+				if(normAlts.size() == 1) {
+					return normAlts[0];
+				}
 
-			return SP<IntersectionType>(normAlts);
+				return static_pointer_cast<Type>(get(normAlts));
+			});
 		}
 
 		string toString() const override {
@@ -562,8 +922,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 	struct PrimitiveType : Type {
 		const PrimitiveTypeID subID;
-		mutable any value;
-
+		mutable any value;  // Interned constants are copied on write
 		PrimitiveType(const bool& v) : Type(TypeID::Primitive, true), subID(PrimitiveTypeID::Boolean), value(v) { cout << toString() << " type created\n"; }
 		PrimitiveType(const double& v) : Type(TypeID::Primitive, true), subID(v != static_cast<int>(v) ? PrimitiveTypeID::Float : PrimitiveTypeID::Integer),
 																		value(v != static_cast<int>(v) ? any(v) : any(static_cast<int>(v))) { cout << toString() << " type created\n"; }
@@ -575,6 +934,106 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 																															   throw invalid_argument("Primitive type cannot be represented by nil")) { cout << toString() << " type created\n"; }
 		~PrimitiveType() { cout << toString() << " type destroyed\n"; }
 
+		static constexpr int minInternedInteger = -128,
+							 maxInternedInteger = 1023;
+
+		/**
+		 * Returns an interned instance for booleans, small integers and other common constants,
+		 * or a new one otherwise. Interned instances live for the whole program and must never
+		 * be mutated in place, see `detached()`.
+		 */
+		static PrimitiveTypeSP get(bool v) {
+			static const PrimitiveTypeSP false_ = intern(SP<PrimitiveType>(false)),
+										 true_ = intern(SP<PrimitiveType>(true));
+
+			return v ? true_ : false_;
+		}
+
+		static PrimitiveTypeSP get(int v) {
+			static const vector<PrimitiveTypeSP> integers = [] {
+				vector<PrimitiveTypeSP> result;
+
+				result.reserve(maxInternedInteger-minInternedInteger+1);
+
+				for(int i = minInternedInteger; i <= maxInternedInteger; i++) {
+					result.push_back(intern(SP<PrimitiveType>(i)));
+				}
+
+				return result;
+			}();
+
+			if(v < minInternedInteger || v > maxInternedInteger) {
+				return SP<PrimitiveType>(v);
+			}
+
+			return integers[v-minInternedInteger];
+		}
+
+		static PrimitiveTypeSP get(double v) {
+			if(v != static_cast<int>(v)) {
+				return SP<PrimitiveType>(v);
+			}
+
+			return get(static_cast<int>(v));
+		}
+
+		static PrimitiveTypeSP get(const string& v) {
+			static const PrimitiveTypeSP empty = intern(SP<PrimitiveType>(""));
+
+			return v.empty() ? empty : SP<PrimitiveType>(v);
+		}
+
+		static PrimitiveTypeSP get(const char* v) {
+			return get(string(v));
+		}
+
+		static PrimitiveTypeSP intern(PrimitiveTypeSP type) {
+			type->interned = true;
+
+			return type;
+		}
+
+		/**
+		 * Returns self if it can be mutated in place or a private copy of an interned constant.
+		 */
+		PrimitiveTypeSP detached() {
+			if(!interned) {
+				return static_pointer_cast<PrimitiveType>(shared_from_this());
+			}
+
+			auto copy = SP<PrimitiveType>(*this);
+
+			copy->interned = false;
+
+			return copy;
+		}
+
+		bool numeric() const {
+			return subID == PrimitiveTypeID::Float ||
+				   subID == PrimitiveTypeID::Integer;
+		}
+
+		/**
+		 * Adds a delta to a numeric value in place, without allocating intermediate values.
+		 * Other kinds of values are not affected by increments and decrements.
+		 */
+		void step(int delta) {
+			switch(subID) {
+				case PrimitiveTypeID::Float:	value = any_cast<double>(value)+delta;	break;
+				case PrimitiveTypeID::Integer:	value = any_cast<int>(value)+delta;		break;
+				default:																break;
+			}
+		}
+
+		/**
+		 * Values of the same kind are accepted alike, unless they are types themselves.
+		 */
+		const void* conformanceKey() const override {
+			static const char kindsKeys[5] {};
+
+			return subID != PrimitiveTypeID::Type ? &kindsKeys[static_cast<usize>(subID)] : nullptr;
+		}
+
 		bool acceptsA(const TypeSP& type) override {
 			if(type->ID == TypeID::Primitive) {
 				auto primType = static_pointer_cast<PrimitiveType>(type);
@@ -631,6 +1090,9 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 		// self = setValue
 		void access(SetRequest SR) override {
+			if(interned) {
+				throw invalid_argument("Shared constant '"+toString()+"' can't be mutated in place");
+			}
 			if(SR.setValue && SR.setValue->ID == TypeID::Primitive) {
 				auto primType = static_pointer_cast<PrimitiveType>(SR.setValue);
 
@@ -643,13 +1105,13 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		TypeSP positive() const override {
 			return subID == PrimitiveTypeID::Type
 				 ? SP<PrimitiveType>(any_cast<TypeSP>(value))
-				 : SP<PrimitiveType>(operator double());
+				 : get(operator double());
 		}
 
 		TypeSP negative() const override {
 			return subID == PrimitiveTypeID::Type
 				 ? SP<PrimitiveType>(any_cast<TypeSP>(value))
-				 : SP<PrimitiveType>(-operator double());
+				 : get(-operator double());
 		}
 
 		TypeSP plus(TypeSP type) const override {
@@ -660,10 +1122,10 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 			auto primType = static_pointer_cast<PrimitiveType>(type);
 
 			if(subID == PrimitiveTypeID::String || primType->subID == PrimitiveTypeID::String) {
-				return SP<PrimitiveType>(operator string()+primType->operator string());
+				return get(operator string()+primType->operator string());
 			}
 
-			return SP<PrimitiveType>(operator double()+primType->operator double());
+			return get(operator double()+primType->operator double());
 		}
 
 		TypeSP minus(TypeSP type) const override {
@@ -673,7 +1135,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 			auto primType = static_pointer_cast<PrimitiveType>(type);
 
-			return SP<PrimitiveType>(operator double()-primType->operator double());
+			return get(operator double()-primType->operator double());
 		}
 
 		// TODO:
@@ -697,29 +1159,56 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		// In theory, Inout will make it possible to "observe" member changes automatically.
 		// In reality, it should call target's accessors which will do all the work.
 		// For example: a++ decomposes to something like scope()->access(AccessPath("a"), SetRequest(scope()->access(AccessPath("a"), GetRequest())->plus(SP<PrimitiveType>(1))))
+		//
+		// UPDATE 2:
+		// Interned constants are shared between all their uses, so they are never stepped in place:
+		// pre-forms return a stepped private copy, post-forms return the constant itself, as the old value.
+		// Storing the new value is up to a storage, see `InoutType::step()`, which does copy-on-write for members.
 
 		TypeSP preIncrement() override {
-			access(SetRequest(positive()->plus(SP<PrimitiveType>(1))));
+			PrimitiveTypeSP target = detached();
 
-			return shared_from_this();
+			target->step(1);
+
+			return target;
 		}
 
 		TypeSP preDecrement() override {
-			access(SetRequest(positive()->minus(SP<PrimitiveType>(1))));
+			PrimitiveTypeSP target = detached();
 
-			return shared_from_this();
+			target->step(-1);
+
+			return target;
 		}
 
 		TypeSP postIncrement() override {
-			access(SetRequest(positive()->plus(SP<PrimitiveType>(1))));
+			if(!numeric()) {
+				return minus(get(1));
+			}
+			if(interned) {
+				return shared_from_this();  // Can't be stepped, the stepped value is stored by InoutType::step()
+			}
+
+			TypeSP oldValue = get(operator double());
 
-			return minus(SP<PrimitiveType>(1));
+			step(1);
+
+			return oldValue;
 		}
 
 		TypeSP postDecrement() override {
-			access(SetRequest(positive()->minus(SP<PrimitiveType>(1))));
+			if(!numeric()) {
+				return plus(get(1));
+			}
+			if(interned) {
+				return shared_from_this();
+			}
+
+			TypeSP oldValue = get(operator double());
+
+			step(-1);
 
-			return plus(SP<PrimitiveType>(1));
+			return oldValue;
 		}
 
 		TypeSP multiply(TypeSP type) const override {
@@ -729,7 +1218,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 			auto primType = static_pointer_cast<PrimitiveType>(type);
 
-			return SP<PrimitiveType>(operator double()*primType->operator double());
+			return get(operator double()*primType->operator double());
 		}
 
 		TypeSP divide(TypeSP type) const override {
@@ -739,7 +1228,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 			auto primType = static_pointer_cast<PrimitiveType>(type);
 
-			return SP<PrimitiveType>(operator double()/primType->operator double());
+			return get(operator double()/primType->operator double());
 		}
 
 		bool equalsTo(const TypeSP& type) override {
@@ -786,18 +1275,32 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 					   							keyType(keyType),
 												valueType(valueType) {}
 
+		/**
+		 * Returns an interned abstract dictionary type. Concrete dictionaries are never shared.
+		 */
+		static DictionaryTypeSP get(const TypeSP& keyType, const TypeSP& valueType) {
+			return internType<DictionaryType>({ TypeID::Dictionary, { keyType, valueType } }, keyType, valueType);
+		}
+
 		bool acceptsA(const TypeSP& type) override {
-			if(type->ID == TypeID::Dictionary) {
-				auto dictType = static_pointer_cast<DictionaryType>(type);
+			return cachedAcceptance(type, [&] {
+				if(type.get() == this) {
+					return true;
+				}
+				if(type->ID == TypeID::Dictionary) {
+					auto dictType = static_pointer_cast<DictionaryType>(type);
 
-				return keyType->acceptsA(dictType->keyType) && valueType->acceptsA(dictType->valueType);
-			}
+					return keyType->acceptsA(dictType->keyType) && valueType->acceptsA(dictType->valueType);
+				}
 
-			return false;
+				return false;
+			});
 		}
 
 		TypeSP normalized() override {
-			return SP<DictionaryType>(keyType->normalized(), valueType->normalized());
+			return cachedNormalized([this] {
+				return static_pointer_cast<Type>(get(keyType->normalized(), valueType->normalized()));
+			});
 		}
 
 		string toString() const override {
@@ -1049,11 +1552,15 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		};
 		unordered_map<int, Retention> retentions;  // Another ID : Retention
 		int life = 1;  // 0 - Creation (, Initialization?), 1 - Idle (, Deinitialization?), 2 - Destruction
+
+	private:
 		std::set<TypeSP> inheritedTypes;  // May be composite (class, struct, protocol), reference to, or function
+
+	public:
 		vector<TypeSP> genericParametersTypes;
 		variant<function<TypeSP(vector<TypeSP>)>, NodeArraySP> statements;
 		unordered_map<string_view, CompositeTypeSP> imports;
-		unordered_map<string_view, Member> members;
+		unordered_map<string, Member, string_hash, equal_to<>> members;  // Owns identifiers, as declarations don't outlive their nodes
 		Observers chainObservers;  // Internal access
 	//	unordered_map<FunctionTypeSP, Observers> subscriptObservers;  // External-internal access
 
@@ -1071,6 +1578,19 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 			// TODO: Statically retain inherited and generic parameters composite types
 		}
 
+		const std::set<TypeSP>& getInheritedTypes() const {
+			return inheritedTypes;
+		}
+
+		/**
+		 * The only way to change inherited types after creation, as conformance results depend on them.
+		 */
+		void setInheritedTypes(const std::set<TypeSP>& types) {
+			inheritedTypes = types;
+
+			invalidateConformances();
+		}
+
 		std::set<TypeSP> getFullInheritanceChain() const {
 			auto chain = inheritedTypes;
 
@@ -1114,20 +1634,22 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		}
 
 		bool acceptsA(const TypeSP& type) {
-			if(type->ID == TypeID::Composite) {
-				auto compThis = static_pointer_cast<CompositeType>(shared_from_this());
-				auto compType = static_pointer_cast<CompositeType>(type);
+			return cachedAcceptance(type, [&] {
+				if(type->ID == TypeID::Composite) {
+					auto compThis = static_pointer_cast<CompositeType>(shared_from_this());
+					auto compType = static_pointer_cast<CompositeType>(type);
 
-				return checkConformance(compThis, compType);
-			}
-			if(type->ID == TypeID::Reference) {
-				auto compThis = static_pointer_cast<CompositeType>(shared_from_this());
-				auto refType = static_pointer_cast<ReferenceType>(type);
+					return checkConformance(compThis, compType);
+				}
+				if(type->ID == TypeID::Reference) {
+					auto compThis = static_pointer_cast<CompositeType>(shared_from_this());
+					auto refType = static_pointer_cast<ReferenceType>(type);
 
-				return checkConformance(compThis, refType->compType, refType->typeArgs);
-			}
+					return checkConformance(compThis, refType->compType, refType->typeArgs);
+				}
 
-			return false;
+				return false;
+			});
 		}
 
 		string toString() const override {
@@ -1192,12 +1714,29 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				throw invalid_argument("Composite is not callable");
 			}
 			if(subID != CompositeTypeID::Function) {
-				return SP<InoutType>(true, SP<NillableType>(PredefinedEAnyTypeSP), InoutType::Path { shared_from_this(), "init" }, true)->access(GR);
+				return SP<InoutType>(true, NillableType::get(PredefinedEAnyTypeSP), InoutType::Path { shared_from_this(), "init" }, true)->access(GR);
 			}
 
-			// TODO: Function call logic
+			auto function = static_pointer_cast<CompositeType>(shared_from_this());
+			TypeSP value;
 
-			return nullptr;
+			interpreter->addCall(function);
+
+			try {
+				if(auto native = get_if<0>(&statements)) {
+					value = (*native)(*GR.arguments);
+				}
+
+				// TODO: Function call logic (statements nodes)
+			} catch(...) {
+				interpreter->removeCall();
+
+				throw;
+			}
+
+			interpreter->removeCall();
+
+			return value;
 		}
 
 		virtual void access(SetRequest SR) override {
@@ -1212,11 +1751,43 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		// var a: getType = this.key(...arguments)
 		// var a: getType = this[...key]
 		// var a: getType = this[...key](...arguments)
-		virtual TypeSP access(AccessPath AP, GetRequest GR) override { return nullptr; }
+		virtual TypeSP access(AccessPath AP, GetRequest GR) override {
+			optional<OverloadCandidate> candidate = findMemberOverload(AP, AccessMode::Get);
+
+			if(!candidate) {
+				return nullptr;
+			}
+
+			OverloadSP& overload = candidate->overload;
+			TypeSP value = applyOverloadAccess(overload->observers, overload, AccessMode::Get, {});
+
+			return GR.arguments && value ? value->access(GR) : value;
+		}
 
 		// this.key = setValue
 		// this[...key] = setValue
-		virtual void access(AccessPath AP, SetRequest SR) override {}
+		virtual void access(AccessPath AP, SetRequest SR) override {
+			optional<OverloadCandidate> candidate = findMemberOverload(AP, AccessMode::Set);
+
+			if(!candidate) {
+				throw invalid_argument("Member '"+std::get<0>(AP.key)+"' is not declared");
+			}
+
+			lock_guard lock(heapMutex());  // Value and retentions change together
+			OverloadSP& overload = candidate->overload;
+
+			if(
+				(SR.setValue && !SR.setValue->conformsTo(overload->type)) ||
+				(!SR.setValue && !PredefinedEVoidTypeSP->conformsTo(overload->type))
+			) {
+				throw invalid_argument("Value '"+to_string(SR.setValue)+"' does not conform to accepting type '"+overload->type->toString()+"'");
+			}
+
+			TypeSP OV = overload->value;  // Old value
+
+			applyOverloadAccess(overload->observers, overload, AccessMode::Set, {}, SR.setValue);
+			candidate->composite->retainOrRelease(OV, overload->value);
+		}
 
 		// delete this.key
 		// delete this[...key]
@@ -1246,7 +1817,11 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 			TypeSP self = shared_from_this();
 
-			interpreter->composites()[ownID].reset();
+			{
+				lock_guard lock(interpreter->heapMutex());
+
+				interpreter->composites()[ownID].reset();
+			}
 
 			unordered_set<int> retainersIDs = getRetainersIDs();
 			int aliveRetainers = 0;
@@ -1289,6 +1864,8 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				return;
 			}
 
+			lock_guard lock(interpreter->heapMutex());
+
 			int retainingID = ownID,
 				retainedID = retainedComposite->ownID;
 			auto& retainingRetentions = retentions,
@@ -1313,6 +1890,8 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				return;
 			}
 
+			lock_guard lock(interpreter->heapMutex());
+
 			int retainingID = ownID,
 				retainedID = retainedComposite->ownID;
 			auto& retainingRetentions = retentions,
@@ -1441,11 +2020,19 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 			return false;
 		}
 
+		recursive_mutex& heapMutex() const {
+			return interpreter->heapMutex();
+		}
+
 		CompositeTypeSP getHierarchy(const string_view& branch) {
+			lock_guard lock(heapMutex());
+
 			return hierarchy.contains(branch) ? hierarchy[branch] : nullptr;
 		}
 
 		void setHierarchy(const string_view& key, CompositeTypeSP value) {
+			lock_guard lock(heapMutex());
+
 			CompositeTypeSP OV = hierarchy[key],  // Old/new value
 							NV = hierarchy[key] = value;
 
@@ -1479,6 +2066,8 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		}
 
 		bool removeHierarchy(const string& key) {
+			lock_guard lock(heapMutex());
+
 			if(auto keyNode = hierarchy.extract(key)) {
 				release(move(keyNode.mapped()));
 
@@ -1489,6 +2078,8 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		}
 
 		bool hierarchyRetains(CompositeTypeSP retainedComposite) {
+			lock_guard lock(heapMutex());
+
 			for(const auto& [key, value] : hierarchy) {
 				if(value == retainedComposite) {
 					return true;
@@ -1597,6 +2188,8 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		}
 
 		optional<reference_wrapper<Member>> getMember(const string_view& identifier) {
+			lock_guard lock(heapMutex());
+
 			auto it = members.find(identifier);
 
 			if(it != members.end()) {
@@ -1607,12 +2200,24 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		}
 
 		Member& addMember(const string_view& identifier) {
-			return members[identifier];
+			lock_guard lock(heapMutex());
+
+			auto it = members.find(identifier);
+
+			if(it == members.end()) {
+				it = members.emplace(identifier, Member()).first;
+			}
+
+			return it->second;
 		}
 
 		void removeMember(const string_view& identifier) {
-			if(auto memberNode = members.extract(identifier)) {
-				Member member = move(memberNode.mapped());
+			lock_guard lock(heapMutex());
+
+			auto it = members.find(identifier);
+
+			if(it != members.end()) {
+				Member member = move(members.extract(it).mapped());
 
 				for(auto& overload : member) {
 					release(overload->value);
@@ -1621,8 +2226,10 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		}
 
 		void removeMembers() {
-			for(auto& [identifier, member] : members) {
-				removeMember(identifier);
+			lock_guard lock(heapMutex());
+
+			while(!members.empty()) {
+				removeMember(members.begin()->first);
 			}
 		}
 
@@ -1675,7 +2282,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 				switch(mode) {
 					case AccessMode::Get:
-						accepting = getType ?: SP<NillableType>(PredefinedEAnyTypeSP);
+						accepting = getType ?: NillableType::get(PredefinedEAnyTypeSP);
 						accepted = overload->observers.get
 								 ? overload->type
 								 : overload->value ?: overload->type;
@@ -1692,11 +2299,11 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 						}
 
 						if(!arguments) {
-							accepting = getType ?: SP<NillableType>(PredefinedEAnyTypeSP);
+							accepting = getType ?: NillableType::get(PredefinedEAnyTypeSP);
 							accepted = overload->value ?: overload->type;
 						} else {
 							accepting = overload->value ?: overload->type;
-							accepted = SP<FunctionType>(vector<TypeSP>(), arguments, SP<NillableType>(PredefinedEAnyTypeSP), FunctionType::Modifiers());
+							accepted = FunctionType::get(vector<TypeSP>(), arguments, NillableType::get(PredefinedEAnyTypeSP), FunctionType::Modifiers());
 						}
 					break;
 				}
@@ -1719,6 +2326,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		 * and can participate in plain scope chains.
 		 */
 		Member findLocalOverloads(const string& identifier) {
+			lock_guard lock(heapMutex());
 			Member overloads;
 
 			// Member
@@ -1781,9 +2389,9 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 							search_.candidates.push_back(candidate);
 						break;
 						case TypeID::Composite:
-							auto compValue = static_pointer_cast<CompositeType>(value);
-
-							compValue->findOverloads("subscript", search_, "scope", mode, false, true);
+							static_pointer_cast<CompositeType>(value)->findOverloads("subscript", search_, "scope", mode, false, true);
+						break;
+						default:  // Other values (primitives, promises) have no subscripts
 						break;
 					}
 				}
@@ -1896,13 +2504,14 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		OverloadSP addOverload(
 			const string& identifier,
 			Overload::Modifiers modifiers = Overload::Modifiers(),
-			TypeSP type = SP<NillableType>(PredefinedEAnyTypeSP),
+			TypeSP type = NillableType::get(PredefinedEAnyTypeSP),
 			Observers observers = Observers()
 		) {
 			if(!type) {
 				throw invalid_argument("Accepting type is nil");
 			}
 
+			lock_guard lock(heapMutex());
 			Member& member = addMember(identifier);
 			auto overload = SP<Overload>(modifiers, type, nullptr, observers);
 
@@ -1996,6 +2605,8 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 						value = observers.get->access(GetRequest(arguments));
 					} else
 					if(overload) {
+						lock_guard lock(heapMutex());
+
 						value = overload->value;
 					}
 					if(observers.didGet) {
@@ -2034,6 +2645,26 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 			return value;
 		}
 
+		/**
+		 * Nearest overload of a named member, as overloads are not matched by types yet (see `matchOverload()`).
+		 */
+		optional<OverloadCandidate> findMemberOverload(const AccessPath& AP, AccessMode mode) {
+			if(AP.key.index() != 0) {
+				throw invalid_argument("Subscripted access is not supported by composites yet");
+			}
+
+			lock_guard lock(heapMutex());  // Hierarchies and chain observers are read along the way
+			OverloadSearch search;
+
+			findOverloads(std::get<0>(AP.key), search, "scope", mode, true);
+
+			if(search.candidates.empty()) {
+				return nullopt;
+			}
+
+			return search.candidates.front();
+		}
+
 		TypeSP accessOverload(
 			variant<string, vector<TypeSP>> key,
 			AccessMode mode,
@@ -2072,19 +2703,31 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 		ReferenceType(const CompositeTypeSP& compType, const optional<vector<TypeSP>>& typeArgs = nullopt) : Type(TypeID::Reference), compType(compType), typeArgs(typeArgs) {}
 
-		bool acceptsA(const TypeSP& type) override {
-			if(type->ID == TypeID::Composite) {
-				auto compType = static_pointer_cast<CompositeType>(type);
+		static ReferenceTypeSP get(const CompositeTypeSP& compType, const optional<vector<TypeSP>>& typeArgs = nullopt) {
+			vector<TypeSP> parts = { compType };
 
-				return CompositeType::checkConformance(compType, compType, typeArgs);
+			if(typeArgs) {
+				parts.insert(parts.end(), typeArgs->begin(), typeArgs->end());
 			}
-			if(type->ID == TypeID::Reference) {
-				auto refType = static_pointer_cast<ReferenceType>(type);
 
-				return CompositeType::checkConformance(compType, refType->compType, refType->typeArgs);
-			}
+			return internType<ReferenceType>({ TypeID::Reference, parts, typeArgs.has_value() }, compType, typeArgs);
+		}
 
-			return false;
+		bool acceptsA(const TypeSP& type) override {
+			return cachedAcceptance(type, [&] {
+				if(type->ID == TypeID::Composite) {
+					auto compType = static_pointer_cast<CompositeType>(type);
+
+					return CompositeType::checkConformance(compType, compType, typeArgs);
+				}
+				if(type->ID == TypeID::Reference) {
+					auto refType = static_pointer_cast<ReferenceType>(type);
+
+					return CompositeType::checkConformance(compType, refType->compType, refType->typeArgs);
+				}
+
+				return false;
+			});
 		}
 
 		TypeSP normalized() override {
@@ -2092,13 +2735,15 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				return shared_from_this();
 			}
 
-			vector<TypeSP> normArgs;
+			return cachedNormalized([this] {
+				vector<TypeSP> normArgs;
 
-			for(const TypeSP& arg : *typeArgs) {
-				normArgs.push_back(arg->normalized());
-			}
+				for(const TypeSP& arg : *typeArgs) {
+					normArgs.push_back(arg->normalized());
+				}
 
-			return SP<ReferenceType>(compType, normArgs);
+				return static_pointer_cast<Type>(get(compType, normArgs));
+			});
 		}
 
 		string toString() const override {
@@ -2134,16 +2779,35 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 						   awaits,
 						   throws;
 		} modifiers;
-		bool liskov;  // Only for call-site checking
+		bool liskov = false;  // Only for call-site checking
 
 		FunctionType(const vector<TypeSP>& genericParametersTypes,
 					 const vector<TypeSP>& parametersTypes,
 					 const TypeSP& returnType,
-					 const Modifiers& modifiers) : genericParametersTypes(genericParametersTypes),
+					 const Modifiers& modifiers) : Type(TypeID::Function),
+												   genericParametersTypes(genericParametersTypes),
 												   parametersTypes(parametersTypes),
 												   returnType(returnType),
 												   modifiers(modifiers) {}
 
+		static FunctionTypeSP get(const vector<TypeSP>& genericParametersTypes,
+								  const vector<TypeSP>& parametersTypes,
+								  const TypeSP& returnType,
+								  const Modifiers& modifiers) {
+			vector<TypeSP> parts = genericParametersTypes;
+
+			parts.insert(parts.end(), parametersTypes.begin(), parametersTypes.end());
+			parts.push_back(returnType);
+
+			usize extra = genericParametersTypes.size();
+
+			for(const optional<bool>& modifier : { modifiers.inits, modifiers.deinits, modifiers.awaits, modifiers.throws }) {
+				extra = extra << 2 | (modifier ? *modifier+1 : 0);  // Nil, false or true
+			}
+
+			return internType<FunctionType>({ TypeID::Function, parts, extra }, genericParametersTypes, parametersTypes, returnType, modifiers);
+		}
+
 		static bool matchTypeLists(const vector<TypeSP>& expectedList, const vector<TypeSP>& providedList) {
 			int expectedSize = expectedList.size(),
 				providedSize = providedList.size();
@@ -2191,36 +2855,43 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		}
 
 		bool acceptsA(const TypeSP& type) override {
-			if(type->ID == TypeID::Composite) {
-				// TODO: Compare with a composite's inherited function type
-			} else
-			if(type->ID == TypeID::Function) {
-				auto funcType = static_pointer_cast<FunctionType>(type);
-
-				return (
-						liskov
-					  ? FunctionType::matchTypeLists(funcType->genericParametersTypes, genericParametersTypes) &&
-						FunctionType::matchTypeLists(funcType->parametersTypes, parametersTypes)
-					  : FunctionType::matchTypeLists(genericParametersTypes, funcType->genericParametersTypes) &&
-						FunctionType::matchTypeLists(parametersTypes, funcType->parametersTypes)
-					   ) &&
-					   (!modifiers.inits   || funcType->modifiers.inits   == modifiers.inits)   &&
-					   (!modifiers.deinits || funcType->modifiers.deinits == modifiers.deinits) &&
-					   (!modifiers.awaits  || funcType->modifiers.awaits  == modifiers.awaits)  &&
-					   (!modifiers.throws  || funcType->modifiers.throws  == modifiers.throws)  &&
-					   returnType->acceptsA(funcType->returnType);
-			}
+			return cachedAcceptance(type, [&] {
+				if(type.get() == this) {
+					return true;
+				}
+				if(type->ID == TypeID::Composite) {
+					// TODO: Compare with a composite's inherited function type
+				} else
+				if(type->ID == TypeID::Function) {
+					auto funcType = static_pointer_cast<FunctionType>(type);
+
+					return (
+							liskov
+						  ? FunctionType::matchTypeLists(funcType->genericParametersTypes, genericParametersTypes) &&
+							FunctionType::matchTypeLists(funcType->parametersTypes, parametersTypes)
+						  : FunctionType::matchTypeLists(genericParametersTypes, funcType->genericParametersTypes) &&
+							FunctionType::matchTypeLists(parametersTypes, funcType->parametersTypes)
+						   ) &&
+						   (!modifiers.inits   || funcType->modifiers.inits   == modifiers.inits)   &&
+						   (!modifiers.deinits || funcType->modifiers.deinits == modifiers.deinits) &&
+						   (!modifiers.awaits  || funcType->modifiers.awaits  == modifiers.awaits)  &&
+						   (!modifiers.throws  || funcType->modifiers.throws  == modifiers.throws)  &&
+						   returnType->acceptsA(funcType->returnType);
+				}
 
-			return false;
+				return false;
+			});
 		}
 
 		TypeSP normalized() override {
-			return SP<FunctionType>(
-				transform(genericParametersTypes, [](const TypeSP& v) { return v->normalized(); }),
-				transform(parametersTypes, [](const TypeSP& v) { return v->normalized(); }),
-				returnType->normalized(),
-				modifiers
-			);
+			return cachedNormalized([this] {
+				return static_pointer_cast<Type>(get(
+					transform(genericParametersTypes, [](const TypeSP& v) { return v->normalized(); }),
+					transform(parametersTypes, [](const TypeSP& v) { return v->normalized(); }),
+					returnType->normalized(),
+					modifiers
+				));
+			});
 		}
 
 		string toString() const override {
@@ -2282,18 +2953,33 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 		~InoutType() { cout << "inout type destroyed\n"; }
 
+		/**
+		 * Returns an interned abstract (explicit and pathless) inout type.
+		 */
+		static InoutTypeSP get(const TypeSP& innerType) {
+			return internType<InoutType>({ TypeID::Inout, { innerType } }, false, innerType, Path {}, false);
+		}
+
 		bool acceptsA(const TypeSP& type) override {
-			return type->ID == TypeID::Inout && innerType->acceptsA(static_pointer_cast<InoutType>(type)->innerType);
+			return cachedAcceptance(type, [&] {
+				return type.get() == this ||
+					   (type->ID == TypeID::Inout && innerType->acceptsA(static_pointer_cast<InoutType>(type)->innerType));
+			});
 		}
 
 		TypeSP normalized() override {
-			auto normInner = innerType->normalized();
+			return cachedNormalized([this] {
+				auto normInner = innerType->normalized();
 
-			if(normInner->ID == TypeID::Inout) {
-				return normInner;
-			}
+				if(normInner->ID == TypeID::Inout) {
+					return normInner;
+				}
+				if(!concrete && !implicit && !internal) {
+					return static_pointer_cast<Type>(get(normInner));
+				}
 
-			return SP<InoutType>(implicit, normInner, path, internal);
+				return static_pointer_cast<Type>(SP<InoutType>(implicit, normInner, path, internal));
+			});
 		}
 
 		string toString() const override {
@@ -2307,11 +2993,15 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		// var a: getType = path
 		// var a: getType = path(...arguments)
 		TypeSP access(GetRequest GR) override {
-			if(path.size() == 1; TypeSP target = evaluatedPath(path)) {
-				return target->access(GR);
+			if(path.size() == 1) {
+				if(TypeSP target = evaluatedPath(path)) {
+					return target->access(GR);
+				}
 			} else
-			if(path.size() >  1; TypeSP target = evaluatedPath(Path(path.begin(), path.end()-1))) {
-				return target->access(AccessPath(pathPartToKey(path.back()), path.size() == 2 || true), GR);
+			if(path.size() > 1) {
+				if(TypeSP target = evaluatedPath(Path(path.begin(), path.end()-1))) {
+					return target->access(AccessPath(pathPartToKey(path.back()), path.size() == 2 || true), GR);
+				}
 			}
 
 			return nullptr;
@@ -2319,21 +3009,29 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 		// path = setValue
 		void access(SetRequest SR) override {
-			if(path.size() == 1; TypeSP target = evaluatedPath(path)) {
-				target->access(SR);
+			if(path.size() == 1) {
+				if(TypeSP target = evaluatedPath(path)) {
+					target->access(SR);
+				}
 			} else
-			if(path.size() >  1; TypeSP target = evaluatedPath(Path(path.begin(), path.end()-1))) {
-				target->access(AccessPath(pathPartToKey(path.back()), path.size() == 2 || true), SR);
+			if(path.size() > 1) {
+				if(TypeSP target = evaluatedPath(Path(path.begin(), path.end()-1))) {
+					target->access(AccessPath(pathPartToKey(path.back()), path.size() == 2 || true), SR);
+				}
 			}
 		}
 
 		// delete path
 		void access(DeleteRequest DR) override {
-			if(path.size() == 1; TypeSP target = evaluatedPath(path)) {
-				target->access(DR);
+			if(path.size() == 1) {
+				if(TypeSP target = evaluatedPath(path)) {
+					target->access(DR);
+				}
 			} else
-			if(path.size() >  1; TypeSP target = evaluatedPath(Path(path.begin(), path.end()-1))) {
-				target->access(AccessPath(pathPartToKey(path.back()), path.size() == 2 || true), DR);
+			if(path.size() > 1) {
+				if(TypeSP target = evaluatedPath(Path(path.begin(), path.end()-1))) {
+					target->access(AccessPath(pathPartToKey(path.back()), path.size() == 2 || true), DR);
+				}
 			}
 		}
 
@@ -2365,6 +3063,57 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 			}
 		}
 
+		TypeSP preIncrement() override {
+			return step(1, false);
+		}
+
+		TypeSP preDecrement() override {
+			return step(-1, false);
+		}
+
+		TypeSP postIncrement() override {
+			return step(1, true);
+		}
+
+		TypeSP postDecrement() override {
+			return step(-1, true);
+		}
+
+		/**
+		 * Steps a number stored at the path. Values held only by the storage are stepped in place, shared ones
+		 * (interned constants, values of other members) are copied-on-write: a stepped value is stored instead.
+		 * Returns the new value, or the old one for post-forms.
+		 */
+		TypeSP step(int delta, bool postfix) {
+			unique_lock<recursive_mutex> lock;  // Value may be shared with async expressions, check and step it at once
+
+			if(!path.empty() && path[0].index() == 2) {
+				if(TypeSP root = std::get<2>(path[0]); root && root->ID == TypeID::Composite) {
+					lock = unique_lock(static_pointer_cast<CompositeType>(root)->heapMutex());
+				}
+			}
+
+			TypeSP value = access(GetRequest());
+
+			if(!value || value->ID != TypeID::Primitive || !static_pointer_cast<PrimitiveType>(value)->numeric()) {
+				return value;
+			}
+
+			auto primitive = static_pointer_cast<PrimitiveType>(move(value));
+
+			if(!primitive->interned && primitive.use_count() <= 2) {  // Storage and this
+				return delta > 0
+					 ? (postfix ? primitive->postIncrement() : primitive->preIncrement())
+					 : (postfix ? primitive->postDecrement() : primitive->preDecrement());
+			}
+
+			TypeSP newValue = PrimitiveType::get(primitive->operator double()+delta);
+
+			access(SetRequest(newValue));
+
+			return postfix ? primitive : newValue;
+		}
+
 		variant<string, vector<TypeSP>> pathPartToKey(const variant<string, vector<TypeSP>, TypeSP>& part) const {
 			switch(part.index()) {
 				case 0:  return std::get<0>(part);
@@ -2428,21 +3177,27 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 		VariadicType(const TypeSP& innerType = nullptr) : Type(TypeID::Variadic), innerType(innerType) {}
 
+		static VariadicTypeSP get(const TypeSP& innerType = nullptr) {
+			return internType<VariadicType>({ TypeID::Variadic, { innerType } }, innerType);
+		}
+
 		bool acceptsA(const TypeSP& type) override {
-			if(!innerType) {
-				return true;
-			}
-			if(type->ID != TypeID::Variadic) {
-				return innerType->acceptsA(type);
-			}
+			return cachedAcceptance(type, [&] {
+				if(!innerType || type.get() == this) {
+					return true;
+				}
+				if(type->ID != TypeID::Variadic) {
+					return innerType->acceptsA(type);
+				}
 
-			auto varType = static_pointer_cast<VariadicType>(type);
+				auto varType = static_pointer_cast<VariadicType>(type);
 
-			if(!varType->innerType) {
-				return innerType->acceptsA(PredefinedEVoidTypeSP);
-			}
+				if(!varType->innerType) {
+					return innerType->acceptsA(PredefinedEVoidTypeSP);
+				}
 
-			return innerType->acceptsA(varType->innerType);
+				return innerType->acceptsA(varType->innerType);
+			});
 		}
 
 		TypeSP normalized() override {
@@ -2450,13 +3205,114 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				return shared_from_this();
 			}
 
-			return SP<VariadicType>(innerType->normalized());
+			return cachedNormalized([this] {
+				return static_pointer_cast<Type>(get(innerType->normalized()));
+			});
 		}
 
 		string toString() const override {
 			return (innerType ? innerType->toString() : "")+"...";
 		}
 	};
+	/**
+	 * Result of a background evaluation, settled once with a value or a thrown error.
+	 */
+	struct PromiseType : Type {
+		using Callback = function<void(const TypeSP&, bool)>;  // Value, rejected
+
+		mutable std::mutex mutex;
+		condition_variable condition;
+		bool settled = false,
+			 rejected = false;
+		TypeSP value;
+		vector<Callback> callbacks;
+
+		PromiseType() : Type(TypeID::Promise, true) {}
+
+		bool pending() const {
+			lock_guard lock(mutex);
+
+			return !settled;
+		}
+
+		bool acceptsA(const TypeSP& type) override {
+			return type->ID == TypeID::Promise;
+		}
+
+		string toString() const override {
+			lock_guard lock(mutex);
+
+			if(!settled) {
+				return "Promise(pending)";
+			}
+
+			return "Promise("+string(rejected ? "throws " : "")+to_string(value)+")";
+		}
+
+		/**
+		 * Callbacks are called on a settling thread, or immediately if already settled.
+		 */
+		void then(Callback callback) {
+			unique_lock lock(mutex);
+
+			if(!settled) {
+				callbacks.push_back(move(callback));
+
+				return;
+			}
+
+			lock.unlock();
+			callback(value, rejected);
+		}
+
+		void settle(const TypeSP& value, bool rejected = false) {
+			vector<Callback> callbacks;
+
+			{
+				lock_guard lock(mutex);
+
+				if(settled) {
+					return;
+				}
+
+				this->value = value;
+				this->rejected = rejected;
+				settled = true;
+				callbacks.swap(this->callbacks);
+			}
+
+			condition.notify_all();
+
+			for(Callback& callback : callbacks) {
+				callback(value, rejected);
+			}
+		}
+
+		/**
+		 * Blocks until settled. Pool workers run pending tasks meanwhile,
+		 * so awaiting from a background evaluation can't starve the pool.
+		 */
+		pair<TypeSP, bool> await() {
+			unique_lock lock(mutex);
+
+			while(!settled) {
+				if(ThreadPool::isWorker()) {
+					lock.unlock();
+					bool helped = sharedThreadPool.runPending();
+					lock.lock();
+
+					if(!helped) {
+						condition.wait_for(lock, chrono::milliseconds(1));
+					}
+				} else {
+					condition.wait(lock);
+				}
+			}
+
+			return make_pair(value, rejected);
+		}
+	};
+
 
 	// ----------------------------------------------------------------
 
@@ -2540,9 +3396,15 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 	CompositeTypeSP createComposite(const string& title, CompositeTypeID type, CompositeTypeSP scope = nullptr) {
 		cout << "createComposite("+title+")" << endl;
-		auto composite = SP<CompositeType>(shared_from_this(), type, title);
+		CompositeTypeSP composite;
+
+		{
+			lock_guard lock(heapMutex());  // Own ID is taken from the registry size
 
-		composites().push_back(composite);
+			composite = SP<CompositeType>(shared_from_this(), type, title);
+
+			composites().push_back(composite);
+		}
 
 		if(scope) {
 			composite->setScope(scope);
@@ -2642,10 +3504,6 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		return value;
 	}
 
-	TypeSP getValueWrapper(const PrimitiveType& value, string identifier) {
-		return getValueWrapper(SP(value), identifier);
-	}
-
 	/**
 	 * Returns a live composite found in value. Works with `CompositeType`.
 	 */
@@ -2687,19 +3545,139 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 	// ----------------------------------------------------------------
 
+	unordered_map<const Node*, TypeSP> constants;  // Node : Folded value
+
+	inline static const unordered_set<string_view> pureInfixOperators = {"+", "-", "*", "/", "==", "!=", "<", ">", "<=", ">="},
+												   purePrefixOperators = {"-", "!"};
+
+	/**
+	 * Returns true if a node is a literal or a pure operator expression whose operands are all already folded.
+	 *
+	 * Literal wrappers (Integer, String, etc.) are not looked up at the moment, if they ever will be,
+	 * literals should only be folded when no wrappers are present in the scope.
+	 */
+	bool foldable(const NodeSP& n) {
+		auto folded = [this](const NodeSP& node) { return node && constants.contains(node.get()); };
+		string type = n->get("type");
+
+		if(type == "booleanLiteral" ||
+		   type == "floatLiteral" ||
+		   type == "integerLiteral") {
+			return true;
+		}
+		if(type == "parenthesizedExpression") {
+			return folded(n->get<NodeSP>("value"));
+		}
+		if(type == "prefixExpression") {
+			NodeSP operator_ = n->get<NodeSP>("operator");
+
+			return (!operator_ || purePrefixOperators.contains(operator_->get<string>("value"))) && folded(n->get<NodeSP>("value"));
+		}
+		if(type == "stringLiteral") {
+			NodeArraySP segments = n->get<NodeArraySP>("segments");
+
+			return !segments || all_of(segments->begin(), segments->end(), [&](const NodeSP& segment) {
+				return segment->get("type") == "stringSegment" || folded(segment->get<NodeSP>("value"));
+			});
+		}
+		if(type == "expressionsSequence") {
+			NodeArraySP values = n->get<NodeArraySP>("values");
+
+			if(!values || values->size() != 3) {
+				return false;
+			}
+
+			NodeSP operator_ = values->at(1);
+
+			return operator_->get("type") == "infixOperator" &&
+				   pureInfixOperators.contains(operator_->get<string>("value")) &&
+				   folded(values->at(0)) &&
+				   folded(values->at(2));
+		}
+
+		return false;
+	}
+
+	/**
+	 * Constant folding pass, meant to be run once between parsing and interpretation.
+	 *
+	 * Walks the tree bottom-up, evaluates foldable nodes with the same rules that would be used
+	 * at runtime, and stores their values, so executeNode() can return them without dispatching
+	 * rules or converting node values again. Nodes which evaluation fails are left as is.
+	 *
+	 * Folded values are interned, so mutating operators can't affect subsequent evaluations.
+	 *
+	 * The walk is recursive as well, so it shares the stack limit of executeNode(). Nodes beyond it are left
+	 * unfolded (with their ancestors), and executeNode() stops at them the same way as without the pass.
+	 */
+	void optimize(const NodeSP& n) {
+		char marker;
+		uintptr_t stackAddress = reinterpret_cast<uintptr_t>(&marker);
+		bool outermost = !nodesStackBase;
+
+		if(outermost) {
+			nodesStackBase = stackAddress;
+		}
+
+		if(nodesStackBase-stackAddress <= nodesStackLimit()) {  // Stack grows down
+			for(const auto& [key, value] : *n) {
+				if(value.type() == 5) {
+					optimize(value.get<NodeSP>());
+				} else
+				if(value.type() == 6) {
+					for(const NodeValue& value_ : *value.get<NodeArraySP>()) {
+						if(value_.type() == 5) {
+							optimize(value_.get<NodeSP>());
+						}
+					}
+				}
+			}
+
+			if(n->contains("type") && foldable(n)) {
+				try {
+					TypeSP value = rules(n->get("type"), n);
+
+					if(value && value->ID == TypeID::Primitive) {
+						constants[n.get()] = PrimitiveType::intern(static_pointer_cast<PrimitiveType>(value));
+					}
+				} catch(exception&) {}
+			}
+		}
+
+		if(outermost) {
+			nodesStackBase = 0;
+		}
+	}
+
 	template<typename... Args>
 	TypeSP executeNode(NodeSP node, bool concrete = true, Args... arguments) {
 		if(!node) {
 			return nullptr;
 		}
+		if(concrete && !constants.empty()) {
+			if(auto it = constants.find(node.get()); it != constants.end()) {
+				return it->second;
+			}
+		}
 
 		int OP = position,  // Old/new position
 			NP = node ? node->get<Node&>("range").get<int>("start") : 0;
 		TypeSP value;
+		char marker;
+		uintptr_t stackAddress = reinterpret_cast<uintptr_t>(&marker);
+		bool outermost = !nodesStackBase;
+
+		if(outermost) {
+			nodesStackBase = stackAddress;
+		}
 
 		position = NP;
 
 		try {
+			if(nodesStackBase-stackAddress > nodesStackLimit()) {  // Stack grows down
+				throw invalid_argument("Maximum call stack size exceeded.\n"+getCallsString());
+			}
+
 			value = rules(node->get("type"), node, arguments...);
 		} catch(exception& e) {
 			value = SP<PrimitiveType>(e.what());
@@ -2716,6 +3694,10 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 
 		position = OP;
 
+		if(outermost) {
+			nodesStackBase = 0;
+		}
+
 		return value;
 	}
 
@@ -2808,7 +3790,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		if(type == "arrayLiteral") {
 			auto value = SP<DictionaryType>(
 				PredefinedPIntegerTypeSP,
-				SP<NillableType>(PredefinedEAnyTypeSP),
+				NillableType::get(PredefinedEAnyTypeSP),
 				true
 			);
 
@@ -2816,27 +3798,80 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				auto value_ = executeNode(n->get<NodeArray&>("values")[i]);
 
 				if(value_) {
-					value->emplace(SP<PrimitiveType>(i), value_);  // TODO: Copy or link value in accordance to type
+					value->emplace(PrimitiveType::get(i), value_);  // TODO: Copy or link value in accordance to type
 				}
 			}
 
 			return getValueWrapper(value, "Array");
 		} else
 		if(type == "arrayType") {
-			TypeSP valueType = executeNode(n->get("value"), false) ?: SP<NillableType>(PredefinedEAnyTypeSP);
+			TypeSP valueType = executeNode(n->get("value"), false) ?: NillableType::get(PredefinedEAnyTypeSP);
 			CompositeTypeSP composite = getValueComposite(nullptr/*findOverload(scope, "Array")?.value*/);
 
 			if(composite) {
-				return SP<ReferenceType>(composite, vector<TypeSP> { valueType });  // TODO: Check if type accepts passed generic argument
+				return ReferenceType::get(composite, vector<TypeSP> { valueType });  // TODO: Check if type accepts passed generic argument
 			} else {
-				return SP<DictionaryType>(PredefinedPIntegerTypeSP, valueType);
+				return DictionaryType::get(PredefinedPIntegerTypeSP, valueType);
 			}
 		} else
 		if(type == "asExpression") {
 			return executeNode(n->get("type_"), false);
 		} else
+		if(type == "asyncExpression") {
+			auto promise = SP<PromiseType>();
+			auto interpreter = SP<Interpreter>(shared_from_this(), InheritedContext(2, 0, 1, 0), code, tokens, tree);
+			NodeSP value = n->get("value");
+
+			{
+				lock_guard lock(heapMutex());
+
+				erase_if(promises(), [](const PromiseTypeSP& promise) { return !promise->pending(); });
+				promises().push_back(promise);
+			}
+
+			sharedThreadPool.add([interpreter, promise, value] {
+				interpreter->addControlTransfer();
+
+				TypeSP result = interpreter->executeNode(value);
+				bool rejected = interpreter->threw();
+
+				if(rejected) {
+					result = interpreter->controlTransfer().value;
+				} else
+				if(result && result->ID == TypeID::Inout) {
+					result = result->access(GetRequest());  // Paths should not be evaluated lazily from another thread
+				}
+
+				interpreter->removeControlTransfer();
+				promise->settle(result, rejected);
+			});
+
+			return promise;
+		} else
+		if(type == "awaitExpression") {
+			TypeSP value = executeNode(n->get("value"));
+
+			if(threw()) {
+				return nullptr;
+			}
+
+			if(value && value->ID == TypeID::Inout) {
+				value = value->access(GetRequest());
+			}
+			if(!value || value->ID != TypeID::Promise) {
+				return value;  // Non-promise values are awaited immediately
+			}
+
+			auto [result, rejected] = static_pointer_cast<PromiseType>(value)->await();
+
+			if(rejected) {
+				setControlTransfer(result, "throw");
+			}
+
+			return result;
+		} else
 		if(type == "booleanLiteral") {
-			return getValueWrapper(n->get("value") == "true", "Boolean");
+			return getValueWrapper(PrimitiveType::get(n->get("value") == "true"), "Boolean");
 		} else
 		if(type == "breakStatement") {
 			TypeSP value;
@@ -2879,7 +3914,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				}
 			}
 
-			return SP<InoutType>(true, SP<NillableType>(PredefinedEAnyTypeSP), InoutType::Path { composite, identifier }, true);
+			return SP<InoutType>(true, NillableType::get(PredefinedEAnyTypeSP), InoutType::Path { composite, identifier }, true);
 		} else
 		if(type == "continueStatement") {
 			TypeSP value;
@@ -2894,7 +3929,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		} else
 		if(type == "defaultType") {
 			if(TypeSP type = executeNode(n->get("value"), false)) {
-				return SP<DefaultType>(type);
+				return DefaultType::get(type);
 			}
 		} else
 		if(type == "deleteExpression") {
@@ -2908,8 +3943,8 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		} else
 		if(type == "dictionaryLiteral") {
 			auto value = SP<DictionaryType>(
-				SP<NillableType>(PredefinedEAnyTypeSP),
-				SP<NillableType>(PredefinedEAnyTypeSP),
+				NillableType::get(PredefinedEAnyTypeSP),
+				NillableType::get(PredefinedEAnyTypeSP),
 				true
 			);
 
@@ -2924,18 +3959,61 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 			return getValueWrapper(value, "Dictionary");
 		} else
 		if(type == "dictionaryType") {
-			TypeSP keyType = executeNode(n->get("key"), false) ?: SP<NillableType>(PredefinedEAnyTypeSP),
-				   valueType = executeNode(n->get("value"), false) ?: SP<NillableType>(PredefinedEAnyTypeSP);
+			TypeSP keyType = executeNode(n->get("key"), false) ?: NillableType::get(PredefinedEAnyTypeSP),
+				   valueType = executeNode(n->get("value"), false) ?: NillableType::get(PredefinedEAnyTypeSP);
 			CompositeTypeSP composite = getValueComposite(nullptr/*findOverload(scope, "Dictionary")?.value*/);
 
 			if(composite) {
-				return SP<ReferenceType>(composite, vector<TypeSP> { keyType, valueType });  // TODO: Check if type accepts passed generic arguments
+				return ReferenceType::get(composite, vector<TypeSP> { keyType, valueType });  // TODO: Check if type accepts passed generic arguments
 			} else {
-				return SP<DictionaryType>(keyType, valueType);
+				return DictionaryType::get(keyType, valueType);
+			}
+		} else
+		if(type == "expressionsSequence") {
+			NodeArray& values = n->get("values");
+
+			// TODO: Assignments, dynamic operators lookup and precedence
+
+			if(values.size() != 3 || values[1].get<NodeSP>()->get("type") != "infixOperator") {
+				return nullptr;
+			}
+
+			string operator_ = values[1].get<NodeSP>()->get("value");
+			TypeSP lhs = executeNode(values[0]);
+
+			if(threw()) {
+				return nullptr;
+			}
+
+			TypeSP rhs = executeNode(values[2]);
+
+			if(threw()) {
+				return nullptr;
+			}
+
+			for(TypeSP* operand : { &lhs, &rhs }) {
+				if(*operand && (*operand)->ID == TypeID::Inout) {
+					*operand = (*operand)->access(GetRequest());  // Operators take values, not paths to them
+				}
+			}
+
+			if(!lhs || !rhs || lhs->ID != TypeID::Primitive || rhs->ID != TypeID::Primitive) {
+				return nullptr;
 			}
+
+			if(operator_ == "+")	return lhs->plus(rhs);
+			if(operator_ == "-")	return lhs->minus(rhs);
+			if(operator_ == "*")	return lhs->multiply(rhs);
+			if(operator_ == "/")	return lhs->divide(rhs);
+			if(operator_ == "==")	return PrimitiveType::get(lhs->equalsTo(rhs));
+			if(operator_ == "!=")	return PrimitiveType::get(lhs->notEqualsTo(rhs));
+			if(operator_ == "<")	return PrimitiveType::get(lhs->operator double() < rhs->operator double());
+			if(operator_ == ">")	return PrimitiveType::get(lhs->operator double() > rhs->operator double());
+			if(operator_ == "<=")	return PrimitiveType::get(lhs->operator double() <= rhs->operator double());
+			if(operator_ == ">=")	return PrimitiveType::get(lhs->operator double() >= rhs->operator double());
 		} else
 		if(type == "floatLiteral") {
-			return getValueWrapper(n->get<double>("value"), "Float");
+			return getValueWrapper(PrimitiveType::get(n->get<double>("value")), "Float");
 		} else
 		if(type == "functionType") {
 			vector<TypeSP> genericParametersTypes,
@@ -2963,10 +4041,10 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 			if(throws > 0) modifiers.throws = true;
 			if(throws < 0) modifiers.throws = false;
 
-			return SP<FunctionType>(genericParametersTypes, parametersTypes, returnType, modifiers);
+			return FunctionType::get(genericParametersTypes, parametersTypes, returnType, modifiers);
 		} else
 		if(type == "identifier") {
-			return SP<InoutType>(true, SP<NillableType>(PredefinedEAnyTypeSP), InoutType::Path { scope(), n->get<string>("value") }, false);
+			return SP<InoutType>(true, NillableType::get(PredefinedEAnyTypeSP), InoutType::Path { scope(), n->get<string>("value") }, false);
 		} else
 		if(type == "ifStatement") {
 			if(n->empty("condition")) {
@@ -3021,10 +4099,10 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				return nullptr;
 			}
 
-			return SP<InoutType>(false, type, InoutType::Path {}, false);
+			return InoutType::get(type);
 		} else
 		if(type == "integerLiteral") {
-			return getValueWrapper(n->get<int>("value"), "Integer");
+			return getValueWrapper(PrimitiveType::get(n->get<int>("value")), "Integer");
 		} else
 		if(type == "intersectionType") {
 			NodeArray& subtypes = n->get("subtypes");
@@ -3051,7 +4129,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				return nullptr;
 			}
 
-			return SP<IntersectionType>(alternatives);
+			return IntersectionType::get(alternatives);
 		} else
 		if(type == "module") {
 			addControlTransfer();
@@ -3075,7 +4153,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		} else
 		if(type == "nillableType") {
 			if(TypeSP type = executeNode(n->get("value"), false)) {
-				return SP<NillableType>(type);
+				return NillableType::get(type);
 			}
 		} else
 		if(type == "nilLiteral") {
@@ -3091,7 +4169,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				return nullptr;
 			}
 
-			return SP<ParenthesizedType>(type);
+			return ParenthesizedType::get(type);
 		} else
 		if(type == "postfixExpression") {
 			auto value = executeNode(n->get("value"));
@@ -3100,7 +4178,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				return nullptr;
 			}
 
-			if(value->ID == TypeID::Primitive && !n->empty("operator")) {
+			if((value->ID == TypeID::Primitive || value->ID == TypeID::Inout) && !n->empty("operator")) {
 				if(n->get<Node&>("operator").get("value") == "++") {
 					return value->postIncrement();
 				}
@@ -3145,11 +4223,11 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				return nullptr;
 			}
 
-			if(value->ID == TypeID::Primitive && !n->empty("operator") ) {
-				if(n->get<Node&>("operator").get("value") == "!") {
-					return SP<PrimitiveType>(value->not_());
+			if((value->ID == TypeID::Primitive || value->ID == TypeID::Inout) && !n->empty("operator")) {
+				if(n->get<Node&>("operator").get("value") == "!" && value->ID == TypeID::Primitive) {
+					return PrimitiveType::get(value->not_());
 				}
-				if(n->get<Node&>("operator").get("value") == "-") {
+				if(n->get<Node&>("operator").get("value") == "-" && value->ID == TypeID::Primitive) {
 					return value->negative();
 				}
 				if(n->get<Node&>("operator").get("value") == "++") {
@@ -3192,7 +4270,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				}
 			}
 
-			return getValueWrapper(string, "String");
+			return getValueWrapper(PrimitiveType::get(string), "String");
 		} else
 		if(type == "subscriptExpression") {
 			TypeSP composite = executeNode(n->get("composite"));
@@ -3219,7 +4297,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				args.push_back(argValue ? argValue->second : nullptr);
 			}
 
-			return SP<InoutType>(true, SP<NillableType>(PredefinedEAnyTypeSP), InoutType::Path { composite, args }, true);
+			return SP<InoutType>(true, NillableType::get(PredefinedEAnyTypeSP), InoutType::Path { composite, args }, true);
 		} else
 		if(type == "throwStatement") {
 			auto value = executeNode(n->get("value"));
@@ -3255,7 +4333,7 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 					}
 				}
 
-				return SP<ReferenceType>(composite, genericArguments);  // TODO: Check if type accepts passed generic arguments
+				return ReferenceType::get(composite, genericArguments);  // TODO: Check if type accepts passed generic arguments
 			}
 		} else
 		if(type == "unionType") {
@@ -3283,28 +4361,33 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 				return nullptr;
 			}
 
-			return SP<UnionType>(alternatives);
+			return UnionType::get(alternatives);
 		} else
 		if(type == "variableDeclaration") {
 			NodeArraySP modifiers = n->get("modifiers");
 
 			for(Node& declarator : n->get<NodeArray&>("declarators")) {
 				string identifier = declarator.get<Node&>("identifier").get("value");
-				TypeSP type = executeNode(declarator.get("type_"), false) ?: SP<NillableType>(PredefinedEAnyTypeSP),
+				TypeSP type = executeNode(declarator.get<NodeSP>("type_"), false) ?: NillableType::get(PredefinedEAnyTypeSP),
 					   value;
 
 			//	addContext({ type: type }, ['implicitChainExpression']);
 
-				value = executeNode(declarator.get("value"));
+				value = executeNode(declarator.get<NodeSP>("value"));
 
 			//	removeContext();
 
+				if(value && value->ID == TypeID::Inout) {
+					value = value->access(GetRequest());  // Values are stored, not paths to them
+				}
+
 				scope()->addOverload(identifier, CompositeType::Overload::Modifiers(), type);
+				scope()->access(AccessPath { identifier, true }, SetRequest(value));
 			//	scope()->accessOverload(identifier, AccessMode::Set, true, nullopt, false, nullptr, value);
 			}
 		} else
 		if(type == "variadicType") {
-			return SP<VariadicType>(executeNode(n->get("value"), false));
+			return VariadicType::get(executeNode(n->get("value"), false));
 		} else
 		if(type == "whileStatement") {
 			if(n->empty("condition")) {
@@ -3354,8 +4437,12 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 	// ----------------------------------------------------------------
 
 	void report(int level, NodeSP node, string string) {
-		Location location = position < tokens.size()
-						  ? tokens[position].location
+		if(!Interface::subscribed(Interface::Source::Interpreter)) {
+			return;
+		}
+
+		Location location = tokens && usize(position) < tokens->size()
+						  ? (*tokens)[position].location
 						  : Location();
 
 		if(node) {
@@ -3382,32 +4469,66 @@ struct Interpreter : enable_shared_from_this<Interpreter> {
 		report(0, nullptr, string);
 	}
 
+	/**
+	 * Async expressions still running on the thread pool are awaited first, as they share the composites.
+	 */
 	void clean() {
+		while(true) {
+			PromiseTypeSP promise;
+
+			{
+				lock_guard lock(heapMutex());
+
+				if(promises().empty()) {
+					break;
+				}
+
+				promise = promises().front();
+				promises().pop_front();
+			}
+
+			promise->await();
+		}
+
+		lock_guard lock(heapMutex());
+
 		position = 0;
+		constants = {};
+		_calls = {};
 		_composites = {};
 		_scopes = {};
 		_controlTransfers = {};
 	}
 
 	TypeSP interpret() {
-		Interface::sendToClients({
-			{"type", "notification"},
-			{"action", "removeAll"},
-			{"source", "interpreter"},
-			{"moduleID", -1}
-		});
+		bool notify = Interface::subscribed(Interface::Source::Interpreter);
+
+		if(notify) {
+			Interface::sendToClients({
+				{"type", "notification"},
+				{"action", "removeAll"},
+				{"source", "interpreter"},
+				{"moduleID", -1}
+			});
+		}
+
+		if(Interface::preferences.optimizations && tree) {
+			optimize(tree);
+		}
 
 		TypeSP value = executeNode(tree);
 
-		Interface::sendToClients({
-			{"type", "notification"},
-			{"source", "interpreter"},
-			{"action", "evaluated"},
-			{"value", to_string(value)}
-		});
+		if(notify) {
+			Interface::sendToClients({
+				{"type", "notification"},
+				{"source", "interpreter"},
+				{"action", "evaluated"},
+				{"value", to_string(value)}
+			});
+		}
 
 		return value;
 	}
 };
 
-static InterpreterSP sharedInterpreter = SP(Interpreter());
\ No newline at end of file
+static InterpreterSP sharedInterpreter = SP<Interpreter>();
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Interface.cpp"
+#include "ThreadPool.cpp"
 
 struct Lexer {
 	struct Location {
@@ -24,6 +25,7 @@ struct Lexer {
 	deque<string> states;  // angle - used to distinguish between common operator and generic type's closing >
 						   // brace - used in statements
 						   // parenthesis - used in string expressions
+	usize chunkSize = 256*1024;  // Codes of at least two chunks are lexed in parallel on the thread pool, 0 - never
 
 	Lexer(string_view code) : code(code) {}
 
@@ -416,7 +418,7 @@ struct Lexer {
 			helpers_specifyOperatorType();
 
 			string type = "identifier";
-			bool chain = atToken([](Token& t) { return t.type.starts_with("operator") && !t.type.ends_with("Postfix") && t.value == "."; });
+			bool chain = atToken(chaining);
 
 			if(keywords.contains(v) && !chain) {  // Disable keywords in a chains
 				type = "keyword";
@@ -507,6 +509,13 @@ struct Lexer {
 
 	// ----------------------------------------------------------------
 
+	/**
+	 * Operator after which identifiers are members of a chain, not keywords.
+	 */
+	static bool chaining(Token& t) {
+		return t.type.starts_with("operator") && !t.type.ends_with("Postfix") && t.value == ".";
+	}
+
 	inline bool codeEnd() {
 		return position >= code.length();
 	}
@@ -565,7 +574,7 @@ struct Lexer {
 	}
 
 	Token& getToken(int offset = 0) {
-		static Token dummy;
+		static thread_local Token dummy;  // Lexers of different modules run concurrently
 
 		return tokens.size() > tokens.size()-1+offset
 			 ? tokens[tokens.size()-1+offset]
@@ -725,10 +734,9 @@ struct Lexer {
 	}
 
 	optional<string> atRegex(const regex& regex) {
-		smatch match;
-		string searchArea = string(code.substr(position));
+		match_results<string_view::const_iterator> match;
 
-		if(regex_search(searchArea, match, regex) && match.position() == 0) {
+		if(regex_search(code.begin()+position, code.end(), match, regex, regex_constants::match_continuous)) {  // Anchored, so the rest of the code is neither copied nor searched
 			return match.str(0);
 		}
 
@@ -768,24 +776,238 @@ struct Lexer {
 		}
 	}
 
+	// ----------------------------------------------------------------
+
+	/**
+	 * Part of the code lexed on its own, as if no states were set at its start.
+	 */
+	struct Chunk {
+		usize start,
+			  end,
+			  newline;  // Last one in front of the start, whitespace between them is a part of the newline token
+		int line;  // Of the newline
+		deque<Token> tokens;  // Led by the newline token
+		deque<string> states;
+		usize position = 0;
+		bool done = false;
+		std::mutex mutex;
+		condition_variable condition;
+
+		/**
+		 * Pool workers run pending tasks meanwhile, as the chunk itself may be queued behind the waiter.
+		 */
+		void await() {
+			unique_lock lock(mutex);
+
+			while(!done) {
+				if(ThreadPool::isWorker()) {
+					lock.unlock();
+					bool helped = sharedThreadPool.runPending();
+					lock.lock();
+
+					if(!helped) {
+						condition.wait_for(lock, chrono::milliseconds(1));
+					}
+				} else {
+					condition.wait(lock);
+				}
+			}
+		}
+	};
+
+	using ChunkSP = sp<Chunk>;
+
+	/**
+	 * Splits the code at least chunkSize apart, before tokens that follow newlines where no comment or string seems to be open.
+	 * Scan only pairs comment delimiters, quotes and parentheses of string expressions,
+	 * states it can't see (e.g. of statements) are found out when chunks are stitched.
+	 */
+	vector<ChunkSP> split() const {
+		vector<ChunkSP> chunks = { SP<Chunk>(0, code.size()) };
+		vector<int> nesting;  // Strings (-1) and their expressions (count of open parentheses)
+		int comments = 0,
+			line = 0;
+		bool lineComment = code.starts_with("#!");
+		usize start = 0,
+			  counted = 0,  // Newlines before it are in the line
+			  newline = string::npos;
+
+		for(usize i = 0; i < code.size(); i++) {
+			char c = code[i],
+				 c_ = i+1 < code.size() ? code[i+1] : 0;
+			bool inString = !nesting.empty() && nesting.back() == -1;
+
+			if(newline != string::npos && !isspace(c) && i-start >= chunkSize) {
+				line += count(code.begin()+counted, code.begin()+newline, '\n');
+				counted = newline;
+				chunks.back()->end = i;
+				chunks.push_back(SP<Chunk>(i, code.size(), newline, line));
+				start = i;
+			}
+
+			if(lineComment) {
+				lineComment = c != '\n';
+			} else
+			if(comments > 0 || (!inString && c == '/' && c_ == '*')) {
+				if(c == '/' && c_ == '*') {
+					comments++;
+					i++;
+				} else
+				if(c == '*' && c_ == '/') {
+					comments--;
+					i++;
+				}
+			} else
+			if(inString) {
+				if(c == '\\' && c_ == '(') {
+					nesting.push_back(0);
+				}
+				if(c == '\\') {
+					i++;
+				}
+				if(c == '\'') {
+					nesting.pop_back();
+				}
+			} else
+			if(c == '/' && c_ == '/') {
+				lineComment = true;
+			} else
+			if(c == '\'') {
+				nesting.push_back(-1);
+			} else
+			if(!nesting.empty() && c == '(') {
+				nesting.back()++;
+			} else
+			if(!nesting.empty() && c == ')') {
+				if(nesting.back() > 0) {
+					nesting.back()--;
+				} else {
+					nesting.pop_back();
+				}
+			}
+
+			if(!isspace(c)) {
+				newline = string::npos;
+			} else
+			if(c == '\n' && !lineComment && comments == 0 && nesting.empty()) {
+				newline = i;
+			}
+		}
+
+		return chunks;
+	}
+
+	/**
+	 * Newline in front of the chunk is represented by a whitespace token, so rules looking back see it as in a sequential run.
+	 * It is only an assumption, checked when the chunk is stitched.
+	 */
+	void tokenizeChunk(Chunk& chunk) {
+		position = chunk.start;
+		tokens = { Token {
+			.position = chunk.newline,
+			.location = { chunk.line, 0 },
+			.type = "whitespace",
+			.value = string(code.substr(chunk.newline, chunk.start-chunk.newline)),
+			.trivia = true,
+			.nonmergeable = false,
+			.generated = false
+		} };
+
+		try {
+			while(position < chunk.end) {
+				nextToken();
+			}
+		} catch(const exception& e) {
+			tokens.clear();  // Lexed again in sequence, so it's thrown there
+		}
+
+		lock_guard lock(chunk.mutex);
+
+		chunk.tokens = move(tokens);
+		chunk.states = move(states);
+		chunk.position = position;
+		chunk.done = true;
+		chunk.condition.notify_all();
+	}
+
+	/**
+	 * Chunk lexed on its own has the same tokens and states as in a sequential run, if that run comes to its start
+	 * with no states set, right after a whitespace, and lexer hasn't appended to the newline token or looked back beyond it.
+	 * Lexer looks back beyond trivia only for chains.
+	 */
+	bool fits(const Chunk& chunk) {
+		if(chunk.tokens.empty()) {
+			return false;
+		}
+
+		const Token& newline = chunk.tokens.front();
+
+		return position == chunk.start && states.empty() && token().type == "whitespace" && !atToken(chaining) &&
+			   newline.type == "whitespace" && newline.position+newline.value.size() == chunk.start;
+	}
+
+	/**
+	 * Chunks are lexed by separate lexers, the first one by this lexer, and stitched in order.
+	 * Chunks that don't fit are lexed again in sequence.
+	 */
+	void tokenizeChunks() {
+		vector<ChunkSP> chunks = split();
+
+		for(usize i = 1; i < chunks.size(); i++) {
+			sharedThreadPool.add([code = code, chunk = chunks[i]] {
+				Lexer(code).tokenizeChunk(*chunk);
+			});
+		}
+
+		while(position < chunks[0]->end) {
+			nextToken();
+		}
+
+		for(usize i = 1; i < chunks.size(); i++) {
+			Chunk& chunk = *chunks[i];
+
+			chunk.await();
+
+			if(fits(chunk)) {
+				tokens.insert(tokens.end(), make_move_iterator(chunk.tokens.begin()+1), make_move_iterator(chunk.tokens.end()));
+				states = move(chunk.states);
+				position = chunk.position;
+			} else {
+				while(position < chunk.end) {
+					nextToken();
+				}
+			}
+		}
+	}
+
 	deque<Token> tokenize() {
-		Interface::sendToClients({
-			{"type", "notification"},
-			{"source", "lexer"},
-			{"action", "removeAll"},
-			{"moduleID", -1}
-		});
+		bool notify = Interface::subscribed(Interface::Source::Lexer);
+
+		if(notify) {
+			Interface::sendToClients({
+				{"type", "notification"},
+				{"source", "lexer"},
+				{"action", "removeAll"},
+				{"moduleID", -1}
+			});
+		}
+
+		if(chunkSize > 0 && code.size() >= chunkSize*2 && sharedThreadPool.size() > 1) {
+			tokenizeChunks();
+		}
 
 		while(!codeEnd()) {
 			nextToken();  // Zero-length position commits will lead to forever loop, rules developer attention is advised
 		}
 
-		Interface::sendToClients({
-			{"type", "notification"},
-			{"source", "lexer"},
-			{"action", "tokenized"},
-			{"tokens", NodeValue(to_string(tokens), true)}
-		});
+		if(notify) {
+			Interface::sendToClients({
+				{"type", "notification"},
+				{"source", "lexer"},
+				{"action", "tokenized"},
+				{"tokens", NodeValue(to_string(tokens), true)}
+			});
+		}
 
 		return tokens;
 	}
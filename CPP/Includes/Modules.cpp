@@ -0,0 +1,178 @@
+#pragma once
+
+#include "Artifacts.cpp"
+#include "ThreadPool.cpp"
+
+/**
+ * Script loaded from a file, with paths of the modules it imports.
+ */
+struct Module {
+	filesystem::path path;
+	ArtifactSP artifact;
+	vector<filesystem::path> imports;  // Found ones only
+};
+
+/**
+ * Loads a script and the modules it imports, transitively.
+ *
+ * Modules are lexed and parsed on the thread pool as soon as their importers are parsed, each by own lexer and parser,
+ * so independent modules are loaded concurrently. Import "A.B" is a file "A/B" next to the importing module.
+ * Loads are muted, as their notifications would interleave, clients are notified of the main module once loaded.
+ * Only top-level imports are followed, as they are the only ones known before interpretation.
+ */
+class ModuleLoader {
+	std::mutex mutex;
+	condition_variable condition;
+	unordered_map<string, Module> modules;  // By canonical path
+	usize pending = 0;
+	exception_ptr failure;  // First one, rethrown by load()
+
+	static void collectPath(const NodeSP& identifier, filesystem::path& path) {
+		if(identifier->get("type") == "chainedIdentifier") {
+			collectPath(identifier->get("supervalue"), path);
+			collectPath(identifier->get("value"), path);
+		} else {
+			path /= identifier->get<string>("value");
+		}
+	}
+
+	/**
+	 * Should be called under the lock.
+	 */
+	void schedule(const filesystem::path& path) {
+		if(!modules.try_emplace(path.string(), Module { .path = path, .artifact = nullptr, .imports = {} }).second) {
+			return;
+		}
+
+		pending++;
+
+		sharedThreadPool.add([this, path] {
+			exception_ptr exception;
+
+			try {
+				Interface::Mute mute;
+				Module module = loadModule(path);
+				lock_guard lock(mutex);
+
+				for(const filesystem::path& importPath : module.imports) {
+					schedule(importPath);
+				}
+
+				modules[path.string()] = move(module);
+			} catch(...) {
+				exception = current_exception();  // Pool would swallow it, leaving load() waiting forever
+			}
+
+			lock_guard lock(mutex);
+
+			if(exception && !failure) {
+				failure = exception;
+			}
+			if(--pending == 0) {
+				condition.notify_all();
+			}
+		});
+	}
+
+	static Module loadModule(const filesystem::path& path) {
+		Module module = { .path = path, .artifact = nullptr, .imports = {} };
+		SourceBufferSP code = read_source(path);
+
+		if(!code) {
+			println("[ModuleLoader] Can't read ", path);
+
+			return module;
+		}
+
+		module.artifact = sharedArtifacts.get(code);
+
+		for(const string& name : importsOf(module.artifact->tree)) {
+			filesystem::path importPath = path.parent_path()/name;
+			error_code error;
+
+			if(filesystem::is_regular_file(importPath, error)) {
+				module.imports.push_back(filesystem::weakly_canonical(importPath, error));
+			} else {
+				println("[ModuleLoader] Module \"", name, "\" imported by ", path, " is not found");
+			}
+		}
+
+		return module;
+	}
+
+	/**
+	 * Post-order from the main module, so dependencies come before their importers. Cycles are cut where they close.
+	 */
+	void order(const filesystem::path& path, unordered_set<string>& visited, vector<Module>& result) {
+		if(!visited.insert(path.string()).second) {
+			return;
+		}
+
+		Module& module = modules.at(path.string());
+
+		for(const filesystem::path& importPath : module.imports) {
+			order(importPath, visited, result);
+		}
+
+		if(module.artifact) {
+			result.push_back(move(module));
+		}
+	}
+
+public:
+	/**
+	 * Names of top-level imports, as relative paths.
+	 */
+	static vector<string> importsOf(const NodeSP& tree) {
+		vector<string> imports;
+
+		NodeArraySP statements = tree ? tree->get<NodeArraySP>("statements") : nullptr;
+
+		if(!statements) {  // Empty or not parsed
+			return imports;
+		}
+
+		for(const NodeValue& statement : *statements) {
+			NodeSP node = statement;
+
+			if(node && node->get("type") == "importDeclaration" && !node->empty("value")) {
+				filesystem::path path;
+
+				collectPath(node->get("value"), path);
+				imports.push_back(path.string());
+			}
+		}
+
+		return imports;
+	}
+
+	/**
+	 * Returns modules in dependency order, the main one is the last. Should not be called from the thread pool.
+	 * Throws the first exception of loading a module, after all scheduled modules are done.
+	 */
+	vector<Module> load(const filesystem::path& path) {
+		error_code error;
+		filesystem::path mainPath = filesystem::weakly_canonical(path, error);
+		vector<Module> result;
+		unordered_set<string> visited;
+
+		unique_lock lock(mutex);
+
+		schedule(mainPath);
+		condition.wait(lock, [&] { return pending == 0; });
+
+		if(exception_ptr exception = failure) {
+			failure = nullptr;
+
+			rethrow_exception(exception);
+		}
+
+		order(mainPath, visited, result);
+
+		if(!result.empty() && result.back().path == mainPath) {
+			sharedArtifacts.notify(result.back().artifact);
+		}
+
+		return result;
+	}
+};
@@ -54,6 +54,7 @@ public:
 	NodeValue(double v) : value(v) {}
 	NodeValue(const char* v, bool serialized = false) : value(string(v)), serialized(serialized) {}
 	NodeValue(const string& v, bool serialized = false) : value(v), serialized(serialized) {}
+	NodeValue(string&& v, bool serialized = false) : value(move(v)), serialized(serialized) {}
 	NodeValue(const Node& v) : value(SP<Node>(v)) {}
 	NodeValue(const NodeSP& v) : value(v ?: static_cast<decltype(value)>(nullptr)) {}
 	NodeValue(const NodeArray& v) : value(SP<NodeArray>(v)) {}
@@ -273,6 +274,13 @@ public:
 		return data.at(key);
 	}
 
+	/**
+	 * Sets value of the key, moving both in.
+	 */
+	void set(string&& key, NodeValue&& value) {
+		data.insert_or_assign(move(key), move(value));
+	}
+
 	/**
 	 * Automatically creates key and should not be naively used for (and before)
 	 * checking if it exists, if the latter can have logical impact.
@@ -322,6 +330,58 @@ public:
 
 // ----------------------------------------------------------------
 
+/**
+ * Returns position of the first quote, backslash or control character starting from a given one, or size if there is none.
+ * Spans are scanned 32 or 16 bytes at a time where AVX2 or SSE2 is available.
+ */
+usize find_json_special(string_view s, usize i) {
+	const char* data = s.data();
+	usize size = s.size();
+
+	#if defined(__AVX2__)
+		const __m256i quote = _mm256_set1_epi8('"'),
+					  backslash = _mm256_set1_epi8('\\'),
+					  control = _mm256_set1_epi8(0x1F);
+
+		for(; i+32 <= size; i += 32) {
+			__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data+i)),
+					special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote),
+															  _mm256_cmpeq_epi8(chunk, backslash)),
+											  _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, control), chunk));  // Unsigned chunk <= 0x1F
+
+			if(u32 mask = _mm256_movemask_epi8(special)) {
+				return i+countr_zero(mask);
+			}
+		}
+	#endif
+	#if defined(__SSE2__)
+		const __m128i quote_ = _mm_set1_epi8('"'),
+					  backslash_ = _mm_set1_epi8('\\'),
+					  control_ = _mm_set1_epi8(0x1F);
+
+		for(; i+16 <= size; i += 16) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data+i)),
+					special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote_),
+														_mm_cmpeq_epi8(chunk, backslash_)),
+										   _mm_cmpeq_epi8(_mm_min_epu8(chunk, control_), chunk));
+
+			if(u32 mask = _mm_movemask_epi8(special)) {
+				return i+countr_zero(mask);
+			}
+		}
+	#endif
+
+	for(; i < size; i++) {
+		char c = data[i];
+
+		if(c == '"' || c == '\\' || u8(c) <= 0x1F) {
+			return i;
+		}
+	}
+
+	return size;
+}
+
 string to_hex(char c) {
 	ostringstream oss;
 
@@ -334,16 +394,37 @@ char from_hex(const string& hexstr) {
 	return stoi(hexstr, nullptr, 16);
 }
 
+/**
+ * Appends a string escaped for JSON, copying runs without special characters at once.
+ */
+void write_escaped_json(string& output, string_view input) {
+	usize i = 0;
+
+	while(true) {
+		usize j = find_json_special(input, i);
+
+		output.append(input.data()+i, j-i);
+
+		if(j >= input.size()) {
+			return;
+		}
+
+		switch(char c = input[j]) {
+			case '"':	output += "\\\"";	break;
+			case '\\':	output += "\\\\";	break;
+			case '\b':	output += "\\b";	break;
+			case '\f':	output += "\\f";	break;
+			case '\n':	output += "\\n";	break;
+			case '\r':	output += "\\r";	break;
+			case '\t':	output += "\\t";	break;
+			default:	output += to_hex(c);	break;  // Control character as \u00XX
+		}
+
+		i = j+1;
+	}
+}
+
 string escape_json(const string& input, bool reverse = false) {
-	static const unordered_map<char, string> escapeMap = {
-		{'\"', "\\\""},
-		{'\\', "\\\\"},
-		{'\b', "\\b"},
-		{'\f', "\\f"},
-		{'\n', "\\n"},
-		{'\r', "\\r"},
-		{'\t', "\\t"}
-	};
 	static const unordered_map<string, char> unescapeMap = {
 		{"\\\"", '\"'},
 		{"\\\\", '\\'},
@@ -357,18 +438,7 @@ string escape_json(const string& input, bool reverse = false) {
 	string result;
 
 	if(!reverse) {
-		for(char c : input) {
-			auto it = escapeMap.find(c);
-
-			if(it != escapeMap.end()) {
-				result += it->second;
-			} else
-			if(c <= 0x1F) {
-				result += to_hex(c);  // Control character as \u00XX
-			} else {
-				result += c;
-			}
-		}
+		write_escaped_json(result, input);
 	} else {
 		usize i = 0;
 
@@ -410,172 +480,719 @@ string unescape_json(const string& input) {
 
 // ----------------------------------------------------------------
 
-static string to_string(const NodeValue& value) {
-	if(value.type() == 4) {
-		return value.serialized ? (string)value : "\""+escape_json((string)value)+"\"";
+void write_number(string& output, int value) {
+	char buffer[16];
+
+	output.append(buffer, to_chars(buffer, buffer+sizeof(buffer), value).ptr);
+}
+
+void write_number(string& output, double value) {
+	char buffer[512];  // Fixed notation of the largest double
+
+	output.append(buffer, to_chars(buffer, buffer+sizeof(buffer), value, chars_format::fixed, 6).ptr);  // As std::to_string
+}
+
+static void write_json(string& output, const Node& node);
+static void write_json(string& output, const NodeArray& array);
+
+/**
+ * Serializers append to a given output in a single pass, so it can be reused or become a message as is.
+ */
+static void write_json(string& output, const NodeValue& value) {
+	switch(value.type()) {
+		case 1:		output += value.get<bool>() ? "true" : "false";		break;
+		case 2:		write_number(output, value.get<int>());				break;
+		case 3:		write_number(output, value.get<double>());			break;
+		case 4:
+			if(value.serialized) {
+				output += value.get<string>();
+			} else {
+				output += '"';
+				write_escaped_json(output, value.get<string>());
+				output += '"';
+			}
+		break;
+		case 5:
+			if(const NodeSP& node = value.get<NodeSP>()) {
+				write_json(output, *node);
+			} else {
+				output += "null";
+			}
+		break;
+		case 6:
+			if(const NodeArraySP& array = value.get<NodeArraySP>()) {
+				write_json(output, *array);
+			} else {
+				output += "null";
+			}
+		break;
+		default:	output += "null";									break;
 	}
+}
 
-	return value;
+static bool empty_json(const NodeValue& value) {
+	return value.type() == 4 && value.serialized && value.get<string>().empty();
 }
 
-static string to_string(const Node& node) {
-    vector<string> content;
+static void write_json(string& output, const Node& node) {
+	bool first = true;
 
-    for(const auto& [k, v] : node) {
-        string s = to_string(v);
+	output += '{';
 
-        if(!s.empty()) {
-            content.push_back("\""+k+"\": "+s);
-        } else {
+	for(const auto& [k, v] : node) {
+		if(empty_json(v)) {
 			println(k, " is empty (why?)");  // Probably will not occur (if this is the case, the entire algorithm can be simplified eliminating if/else)
+
+			continue;
+		}
+		if(!first) {
+			output += ", ";
 		}
-    }
 
-    return "{"+join(content, ", ")+"}";
-}
+		output += '"';
+		write_escaped_json(output, k);
+		output += "\": ";
+		write_json(output, v);
+		first = false;
+	}
 
-static string to_string(const NodeArray& node) {
-	string result = "[";
-	auto it = node.begin();
+	output += '}';
+}
 
-	while(it != node.end()) {
-		auto& v = *it;
-		string s = to_string(v);
+static void write_json(string& output, const NodeArray& array) {
+	bool first = true;
 
-		if(!s.empty()) {
-			result += s;
+	output += '[';
 
-			if(next(it) != node.end()) {
-				result += ", ";
-			}
+	for(const NodeValue& v : array) {
+		if(empty_json(v)) {
+			continue;
+		}
+		if(!first) {
+			output += ", ";
 		}
 
-		it++;
+		write_json(output, v);
+		first = false;
 	}
 
-	result += "]";
+	output += ']';
+}
+
+static string to_string(const NodeValue& value) {
+	string result;
+
+	write_json(result, value);
 
 	return result;
 }
 
+static string to_string(const Node& node) {
+	string result;
+
+	write_json(result, node);
+
+	return result;
+}
+
+static string to_string(const NodeArray& array) {
+	string result;
+
+	write_json(result, array);
+
+	return result;
+}
+
+/**
+ * Compares values deeply, unlike operator== that compares nodes and arrays by identity.
+ * Other values are compared by their JSON, pre-serialized strings also by the flag if `compareSerialized` is set.
+ */
+static bool deep_equal(const NodeValue& a, const NodeValue& b, bool compareSerialized = false) {
+	if(a.type() != b.type() || (compareSerialized && a.serialized != b.serialized)) {
+		return false;
+	}
+
+	switch(a.type()) {
+		case 5: {
+			const NodeSP& x = a.get<NodeSP>();
+			const NodeSP& y = b.get<NodeSP>();
+
+			return !x || !y ? x == y : x->size() == y->size() && all_of(x->begin(), x->end(), [&](auto& v) {
+				return y->contains(v.first) && deep_equal(v.second, y->get(v.first), compareSerialized);
+			});
+		}
+		case 6: {
+			const NodeArraySP& x = a.get<NodeArraySP>();
+			const NodeArraySP& y = b.get<NodeArraySP>();
+
+			return !x || !y ? x == y : x->size() == y->size() && equal(x->begin(), x->end(), y->begin(), [&](auto& v, auto& w) {
+				return deep_equal(v, w, compareSerialized);
+			});
+		}
+		default:
+			return to_string(a) == to_string(b);
+	}
+}
+
 // ----------------------------------------------------------------
 
+/**
+ * Strict JSON parser that builds nodes directly.
+ *
+ * Malformed input results in an empty value, with the reason and position kept in the error.
+ */
 class NodeParser {
-	string s;
-	usize i = 0;
+	string_view s;
+	usize i = 0,
+		  depth = 0;
+
+	static constexpr usize depthLimit = 1024;
+
+	NodeValue fail(const string& reason) {
+		if(error.empty()) {
+			error = reason+" at "+std::to_string(i);
+		}
+
+		i = s.size();
+
+		return NodeValue();
+	}
 
 	void skipWhitespace() {
-		while(i < s.size() && isspace(s[i])) {
+		while(i < s.size() && (s[i] == ' ' || s[i] == '\n' || s[i] == '\r' || s[i] == '\t')) {
 			i++;
 		}
 	}
 
-	string parseString() {
-		string result;
+	optional<u32> parseHex() {
+		u32 value = 0;
+
+		if(s.size()-i < 4 || from_chars(s.data()+i, s.data()+i+4, value, 16).ptr != s.data()+i+4) {
+			return nullopt;
+		}
+
+		i += 4;
+
+		return value;
+	}
+
+	static void appendUTF8(string& result, u32 c) {
+		if(c < 0x80) {
+			result += char(c);
+		} else
+		if(c < 0x800) {
+			result += char(0xC0 | (c >> 6));
+			result += char(0x80 | (c&0x3F));
+		} else
+		if(c < 0x10000) {
+			result += char(0xE0 | (c >> 12));
+			result += char(0x80 | ((c >> 6)&0x3F));
+			result += char(0x80 | (c&0x3F));
+		} else {
+			result += char(0xF0 | (c >> 18));
+			result += char(0x80 | ((c >> 12)&0x3F));
+			result += char(0x80 | ((c >> 6)&0x3F));
+			result += char(0x80 | (c&0x3F));
+		}
+	}
+
+	bool parseEscape(string& result) {
+		if(++i >= s.size()) {
+			return false;
+		}
 
-		if (i >= s.size() || s[i] != '"') return result;
+		switch(s[i++]) {
+			case '"':	result += '"';	break;
+			case '\\':	result += '\\';	break;
+			case '/':	result += '/';	break;
+			case 'b':	result += '\b';	break;
+			case 'f':	result += '\f';	break;
+			case 'n':	result += '\n';	break;
+			case 'r':	result += '\r';	break;
+			case 't':	result += '\t';	break;
+			case 'u': {
+				optional<u32> c = parseHex();
+
+				if(!c) {
+					return false;
+				}
+				if(*c >= 0xD800 && *c < 0xDC00 && s.substr(i, 2) == "\\u") {  // Surrogate pair
+					usize highEnd = i;
+
+					i += 2;
+
+					optional<u32> low = parseHex();
+
+					if(low && *low >= 0xDC00 && *low < 0xE000) {
+						*c = 0x10000+((*c-0xD800) << 10)+(*low-0xDC00);
+					} else {
+						i = highEnd;
+					}
+				}
+
+				appendUTF8(result, *c);
+			}
+			break;
+			default:
+				return false;
+		}
+
+		return true;
+	}
+
+	bool parseString(string& result) {
 		i++;
 
-		string raw;
-		while (i < s.size()) {
-			if (s[i] == '"') {
+		while(true) {
+			usize j = find_json_special(s, i);
+
+			result.append(s.data()+i, j-i);
+			i = j;
+
+			if(i >= s.size()) {
+				fail("Unterminated string");
+
+				return false;
+			}
+
+			char c = s[i];
+
+			if(c == '"') {
 				i++;
-				break;
+
+				return true;
 			}
+			if(c == '\\') {
+				if(!parseEscape(result)) {
+					fail("Invalid escape sequence");
 
-			if (s[i] == '\\') {
-				if (i + 1 >= s.size()) break; // некорректный конец
-				raw += s[i];   // '\'
-				raw += s[i+1]; // следующий символ ('n', 'u', '"', и т.д.)
-				i += 2;
-				if (raw.back() == 'u') {
-					// захватываем еще 4 hex-цифры для \uXXXX
-					if (i + 4 <= s.size()) {
-						raw += s.substr(i, 4);
-						i += 4;
-					} else {
-						break; // некорректный \uXXXX
-					}
+					return false;
 				}
 			} else {
-				raw += s[i++];
+				result += c;  // Unescaped control characters are tolerated
+				i++;
 			}
 		}
-
-		return unescape_json(raw);
 	}
 
 	NodeValue parseNumber() {
 		usize start = i;
-		bool isFloat = false;
-		while(i < s.size() && (isdigit(s[i]) || s[i] == '.' || s[i] == '-' || s[i] == '+')) {
-			if(s[i] == '.') isFloat = true;
+		bool integer = true;
+
+		auto skipDigits = [&]() {
+			while(i < s.size() && isdigit(s[i])) {
+				i++;
+			}
+		};
+
+		if(s[i] == '-') {
 			i++;
 		}
-		string num = s.substr(start, i-start);
-		try {
-			return isFloat ? NodeValue(stod(num)) : NodeValue(stoi(num));
-		} catch(...) {
-			return nullptr;
+
+		skipDigits();
+
+		if(i < s.size() && s[i] == '.') {
+			integer = false;
+			i++;
+			skipDigits();
+		}
+		if(i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+			integer = false;
+			i++;
+
+			if(i < s.size() && (s[i] == '+' || s[i] == '-')) {
+				i++;
+			}
+
+			skipDigits();
+		}
+
+		const char* first = s.data()+start;
+		const char* last = s.data()+i;
+
+		if(integer) {
+			int value;
+			auto [end, code] = from_chars(first, last, value);
+
+			if(code == errc() && end == last) {
+				return value;
+			}
 		}
+
+		double value;  // Also integers out of int range
+		auto [end, code] = from_chars(first, last, value);
+
+		if(end != last || (code != errc() && code != errc::result_out_of_range)) {
+			return fail("Invalid number");
+		}
+		if(code == errc::result_out_of_range) {
+			return nullptr;  // Not representable
+		}
+
+		return value;
 	}
 
 	NodeValue parseArray() {
-		NodeArray array;
+		NodeArraySP array = SP<NodeArray>();
+
 		i++;
-		while(i < s.size()) {
-			skipWhitespace();
-			if(s[i] == ']') { i++; break; }
-			array.push_back(parseValue());
+		skipWhitespace();
+
+		if(i < s.size() && s[i] == ']') {
+			i++;
+
+			return array;
+		}
+
+		while(true) {
+			array->push_back(parseValue());
+
+			if(!error.empty()) {
+				return NodeValue();
+			}
+
 			skipWhitespace();
-			if(s[i] == ',') i++;
-			else if(s[i] == ']') { i++; break; }
-			else i++;
+
+			if(i < s.size() && s[i] == ',') {
+				i++;
+			} else
+			if(i < s.size() && s[i] == ']') {
+				i++;
+
+				return array;
+			} else {
+				return fail("Expected , or ]");
+			}
 		}
-		return SP(array);
 	}
 
 	NodeValue parseNode() {
-		Node node;
+		NodeSP node = SP<Node>();
+
 		i++;
-		while(i < s.size()) {
-			skipWhitespace();
-			if(s[i] == '}') { i++; break; }
+		skipWhitespace();
+
+		if(i < s.size() && s[i] == '}') {
+			i++;
+
+			return node;
+		}
 
-			string key = parseString();
+		while(true) {
 			skipWhitespace();
-			if(s[i] == ':') i++;
+
+			string key;
+
+			if(i >= s.size() || s[i] != '"') {
+				return fail("Expected key");
+			}
+			if(!parseString(key)) {
+				return NodeValue();
+			}
+
 			skipWhitespace();
-			node[key] = parseValue();
+
+			if(i >= s.size() || s[i] != ':') {
+				return fail("Expected :");
+			}
+
+			i++;
+
+			NodeValue value = parseValue();
+
+			if(!error.empty()) {
+				return NodeValue();
+			}
+
+			node->set(move(key), move(value));
 			skipWhitespace();
-			if(s[i] == ',') i++;
-			else if(s[i] == '}') { i++; break; }
-			else i++;
+
+			if(i < s.size() && s[i] == ',') {
+				i++;
+			} else
+			if(i < s.size() && s[i] == '}') {
+				i++;
+
+				return node;
+			} else {
+				return fail("Expected , or }");
+			}
 		}
-		return SP(node);
 	}
 
 	NodeValue parseValue() {
 		skipWhitespace();
-		if(i >= s.size()) return nullptr;
+
+		if(i >= s.size()) {
+			return fail("Unexpected end");
+		}
+
 		char c = s[i];
 
-		if(c == '"') return parseString();
-		if(c == '-' || isdigit(c)) return parseNumber();
-		if(s.compare(i, 4, "true") == 0) { i += 4; return true; }
-		if(s.compare(i, 5, "false") == 0) { i += 5; return false; }
-		if(s.compare(i, 4, "null") == 0) { i += 4; return nullptr; }
-		if(c == '[') return parseArray();
-		if(c == '{') return parseNode();
+		if(c == '"') {
+			string value;
 
-		i++;
-		return nullptr;
+			if(!parseString(value)) {
+				return NodeValue();
+			}
+
+			return value;
+		}
+		if(c == '-' || isdigit(c)) {
+			return parseNumber();
+		}
+		if(s.compare(i, 4, "true") == 0) {
+			i += 4;
+
+			return true;
+		}
+		if(s.compare(i, 5, "false") == 0) {
+			i += 5;
+
+			return false;
+		}
+		if(s.compare(i, 4, "null") == 0) {
+			i += 4;
+
+			return nullptr;
+		}
+		if(c == '[' || c == '{') {
+			if(++depth > depthLimit) {
+				return fail("Nesting is too deep");
+			}
+
+			NodeValue value = c == '[' ? parseArray() : parseNode();
+
+			depth--;
+
+			return value;
+		}
+
+		return fail("Unexpected character");
 	}
 
 public:
-	NodeParser(const string& input) : s(input) {}
+	string error;  // Empty if parsed
+
+	NodeParser(string_view input) : s(input) {}  // Input should outlive the parser
 
 	NodeValue parse() {
-		return parseValue();
+		NodeValue value = parseValue();
+
+		skipWhitespace();
+
+		if(error.empty() && i < s.size()) {
+			fail("Unexpected trailing characters");
+		}
+
+		return error.empty() ? value : NodeValue();
 	}
-};
\ No newline at end of file
+};
+
+// ----------------------------------------------------------------
+
+/**
+ * Lazy view of a JSON object: indexes top-level fields by offsets without parsing their values,
+ * so a few of them can be read, and others removed or added, without reserializing the rest.
+ */
+class NodeView {
+	struct Field {
+		string key;
+		usize start,       // Key
+			  valueStart,
+			  end;         // After value
+	};
+
+	string_view s;
+	usize i = 0;
+	vector<Field> fields;
+	bool valid = false;
+
+	void skipWhitespace() {
+		while(i < s.size() && isspace(s[i])) {
+			i++;
+		}
+	}
+
+	bool skipString() {
+		for(i++; (i = find_json_special(s, i)) < s.size(); i++) {
+			if(s[i] == '\\') {
+				i++;
+			} else
+			if(s[i] == '"') {
+				i++;
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool skipValue() {
+		skipWhitespace();
+
+		if(i >= s.size()) {
+			return false;
+		}
+		if(s[i] == '"') {
+			return skipString();
+		}
+		if(s[i] == '{' || s[i] == '[') {
+			usize depth = 0;
+
+			while(i < s.size()) {
+				char c = s[i];
+
+				if(c == '"') {
+					if(!skipString()) {
+						return false;
+					}
+
+					continue;
+				}
+				if(c == '{' || c == '[') {
+					depth++;
+				} else
+				if((c == '}' || c == ']') && --depth == 0) {
+					i++;
+
+					return true;
+				}
+
+				i++;
+			}
+
+			return false;
+		}
+
+		usize start = i;
+
+		while(i < s.size() && s[i] != ',' && s[i] != '}' && s[i] != ']' && !isspace(s[i])) {
+			i++;
+		}
+
+		return i > start;
+	}
+
+	bool index() {
+		skipWhitespace();
+
+		if(i >= s.size() || s[i] != '{') {
+			return false;
+		}
+
+		i++;
+		skipWhitespace();
+
+		if(i < s.size() && s[i] == '}') {
+			return true;
+		}
+
+		while(i < s.size()) {
+			skipWhitespace();
+
+			usize start = i;
+
+			if(i >= s.size() || s[i] != '"' || !skipString()) {
+				return false;
+			}
+
+			string_view key = s.substr(start+1, i-start-2);
+
+			skipWhitespace();
+
+			if(i >= s.size() || s[i] != ':') {
+				return false;
+			}
+
+			i++;
+			skipWhitespace();
+
+			usize valueStart = i;
+
+			if(!skipValue()) {
+				return false;
+			}
+
+			fields.push_back({
+				key.contains('\\') ? (string)NodeParser(s.substr(start, i-start)).parse() : string(key),
+				start,
+				valueStart,
+				i
+			});
+			skipWhitespace();
+
+			if(i < s.size() && s[i] == ',') {
+				i++;
+			} else {
+				return i < s.size() && s[i] == '}';
+			}
+		}
+
+		return false;
+	}
+
+public:
+	NodeView(string_view input) : s(input) {  // Input should outlive the view
+		valid = index();
+	}
+
+	/**
+	 * Parses only given fields into a node.
+	 */
+	NodeSP parse(const unordered_set<string_view>& keys) const {
+		if(!valid) {
+			return nullptr;
+		}
+
+		NodeSP node = SP<Node>();
+
+		for(const Field& field : fields) {
+			if(keys.contains(field.key)) {
+				(*node)[field.key] = NodeParser(s.substr(field.valueStart, field.end-field.valueStart)).parse();
+			}
+		}
+
+		return node;
+	}
+
+	/**
+	 * Copies original text of fields except removed ones and appends added (replacing) ones.
+	 */
+	optional<string> splice(const unordered_set<string_view>& removedKeys, const Node& addedFields) const {
+		if(!valid) {
+			return nullopt;
+		}
+
+		string result = "{";
+		bool empty = true;
+
+		result.reserve(s.size()+addedFields.size()*32);
+
+		for(const Field& field : fields) {
+			if(removedKeys.contains(field.key) || addedFields.contains(field.key)) {
+				continue;
+			}
+			if(!empty) {
+				result += ", ";
+			}
+
+			result += s.substr(field.start, field.end-field.start);
+			empty = false;
+		}
+
+		for(auto& [key, value] : addedFields) {
+			if(!empty) {
+				result += ", ";
+			}
+
+			result += "\""+escape_json(key)+"\": "+to_string(value);
+			empty = false;
+		}
+
+		result += "}";
+
+		return result;
+	}
+};
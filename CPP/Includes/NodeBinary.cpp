@@ -0,0 +1,616 @@
+#pragma once
+
+#include "Node.cpp"
+
+/**
+ * Compact binary encoding of node trees, negotiated by IPC peers as an alternative to JSON.
+ *
+ * Message is a magic byte (never a first byte of JSON), a table of interned strings (keys and short values)
+ * and a root value. Containers are prefixed with byte size of their content, so any value can be skipped
+ * without decoding, e.g. a router reads only the header fields it routes on and copies the rest as is.
+ */
+namespace NodeBinary {
+	constexpr char magic = '\xC1';
+	constexpr usize internedSizeLimit = 32;
+
+	enum class Tag : u8 {
+		Null,
+		False,
+		True,
+		Integer,   // Zigzag varint
+		Double,    // 8 bytes
+		String,    // Varint size, bytes
+		Interned,  // Varint index in the table
+		JSON,      // Pre-serialized value (see NodeValue::serialized), varint size, bytes
+		Node,      // 4 bytes content size, varint count, pairs of string key and value
+		Array      // 4 bytes content size, varint count, values
+	};
+
+	bool is(string_view message) {
+		return !message.empty() && message[0] == magic;
+	}
+
+	void writeVarint(string& output, u64 value) {
+		while(value >= 0x80) {
+			output += char((value&0x7F) | 0x80);
+			value >>= 7;
+		}
+
+		output += char(value);
+	}
+
+	// ----------------------------------------------------------------
+
+	class Encoder {
+		unordered_map<string_view, usize> indices;  // Encoded values should outlive the encoder
+		usize base;
+
+		usize beginContainer(Tag tag, usize count) {
+			body += char(tag);
+
+			usize sizePosition = body.size();
+
+			body.append(4, '\0');
+			writeVarint(body, count);
+
+			return sizePosition;
+		}
+
+		void endContainer(usize sizePosition) {
+			u32 size = body.size()-sizePosition-4;
+
+			memcpy(&body[sizePosition], &size, 4);
+		}
+
+	public:
+		string table,
+			   body;
+
+		/**
+		 * Base is a count of strings that are already in the table of a message being extended.
+		 */
+		Encoder(usize base = 0) : base(base) {}
+
+		usize count() const {
+			return indices.size();
+		}
+
+		void encode(string_view s) {
+			if(s.size() > internedSizeLimit) {
+				body += char(Tag::String);
+				writeVarint(body, s.size());
+				body += s;
+
+				return;
+			}
+
+			auto [it, inserted] = indices.try_emplace(s, base+indices.size());
+
+			if(inserted) {
+				writeVarint(table, s.size());
+				table += s;
+			}
+
+			body += char(Tag::Interned);
+			writeVarint(body, it->second);
+		}
+
+		void encode(const Node& node) {
+			usize sizePosition = beginContainer(Tag::Node, node.size());
+
+			for(auto& [key, value] : node) {
+				encode(string_view(key));
+				encode(value);
+			}
+
+			endContainer(sizePosition);
+		}
+
+		void encode(const NodeArray& array) {
+			usize sizePosition = beginContainer(Tag::Array, array.size());
+
+			for(const NodeValue& value : array) {
+				encode(value);
+			}
+
+			endContainer(sizePosition);
+		}
+
+		void encode(const NodeValue& value) {
+			switch(value.type()) {
+				case 1:
+					body += char(value.get<bool>() ? Tag::True : Tag::False);
+				break;
+				case 2: {
+					i64 integer = value.get<int>();
+
+					body += char(Tag::Integer);
+					writeVarint(body, u64(integer) << 1 ^ u64(integer >> 63));
+				}
+				break;
+				case 3: {
+					double number = value.get<double>();
+
+					body += char(Tag::Double);
+					body.append(reinterpret_cast<const char*>(&number), 8);
+				}
+				break;
+				case 4:
+					if(value.serialized) {
+						body += char(Tag::JSON);
+						writeVarint(body, value.get<string>().size());
+						body += value.get<string>();
+					} else {
+						encode(string_view(value.get<string>()));
+					}
+				break;
+				case 5:
+					encode(*value.get<NodeSP>());
+				break;
+				case 6:
+					encode(*value.get<NodeArraySP>());
+				break;
+				default:
+					body += char(Tag::Null);
+				break;
+			}
+		}
+
+		/**
+		 * Returns a complete message of the table and the body.
+		 */
+		string message() const {
+			string result(1, magic);
+
+			result.reserve(16+table.size()+body.size());
+			writeVarint(result, count());
+			result += table;
+			result += body;
+
+			return result;
+		}
+	};
+
+	string encode(const NodeValue& value) {
+		Encoder encoder;
+
+		encoder.encode(value);
+
+		return encoder.message();
+	}
+
+	// ----------------------------------------------------------------
+
+	/**
+	 * Reads a message in place. Malformed input fails the decoder instead of throwing,
+	 * so its results (empty values and strings) should be discarded then.
+	 */
+	class Decoder {
+		string_view s;
+		usize i = 0,
+			  tableStart = 0,
+			  tableEnd = 0,
+			  depth = 0;
+		vector<string_view> strings;
+
+		static constexpr usize depthLimit = 1024;  // Containers are read recursively, as by NodeParser
+
+		bool has(usize size) {
+			if(i > s.size() || s.size()-i < size) {
+				failed = true;
+			}
+
+			return !failed;
+		}
+
+		u8 readByte() {
+			return has(1) ? s[i++] : 0;
+		}
+
+		u64 readVarint() {
+			u64 value = 0;
+
+			for(usize shift = 0; shift < 64 && has(1); shift += 7) {
+				u8 byte = s[i++];
+
+				value |= u64(byte&0x7F) << shift;
+
+				if(!(byte&0x80)) {
+					return value;
+				}
+			}
+
+			failed = true;
+
+			return 0;
+		}
+
+		u32 readSize() {
+			u32 size = 0;
+
+			if(has(4)) {
+				memcpy(&size, &s[i], 4);
+				i += 4;
+			}
+
+			return size;
+		}
+
+		string_view readBytes(usize size) {
+			if(!has(size)) {
+				return string_view();
+			}
+
+			string_view bytes = s.substr(i, size);
+
+			i += size;
+
+			return bytes;
+		}
+
+		string_view readString(Tag tag) {
+			if(tag == Tag::String || tag == Tag::JSON) {
+				return readBytes(readVarint());
+			}
+			if(tag == Tag::Interned) {
+				usize index = readVarint();
+
+				if(index < strings.size()) {
+					return strings[index];
+				}
+			}
+
+			failed = true;
+
+			return string_view();
+		}
+
+		string_view readKey() {
+			return readString(Tag(readByte()));
+		}
+
+		i64 readInteger() {
+			u64 value = readVarint();
+
+			return i64(value >> 1 ^ -(value&1));
+		}
+
+		double readDouble() {
+			double value = 0;
+
+			if(has(8)) {
+				memcpy(&value, &s[i], 8);
+				i += 8;
+			}
+
+			return value;
+		}
+
+		/**
+		 * Reads content size and count of a container, returning the position of its end.
+		 */
+		usize readContainer(usize& count) {
+			usize size = readSize(),
+				  end = i+size;
+
+			count = readVarint();
+
+			if(!has(end-min(i, end)) || count > size) {
+				failed = true;
+				count = 0;
+			}
+
+			return end;
+		}
+
+		void skip() {
+			switch(Tag(readByte())) {
+				case Tag::Null:
+				case Tag::False:
+				case Tag::True:
+				break;
+				case Tag::Integer:
+				case Tag::Interned:
+					readVarint();
+				break;
+				case Tag::Double:
+					readBytes(8);
+				break;
+				case Tag::String:
+				case Tag::JSON:
+					readBytes(readVarint());
+				break;
+				case Tag::Node:
+				case Tag::Array:
+					readBytes(readSize());
+				break;
+				default:
+					failed = true;
+				break;
+			}
+		}
+
+		NodeValue decodeNode() {
+			usize count;
+			usize end = readContainer(count);
+			Node node;
+
+			for(usize j = 0; j < count && !failed; j++) {
+				string key(readKey());
+
+				node[key] = decode();
+			}
+
+			if(i != end) {
+				failed = true;
+			}
+
+			return SP(node);
+		}
+
+		NodeValue decodeArray() {
+			usize count;
+			usize end = readContainer(count);
+			NodeArray array;
+
+			array.reserve(count);
+
+			for(usize j = 0; j < count && !failed; j++) {
+				array.push_back(decode());
+			}
+
+			if(i != end) {
+				failed = true;
+			}
+
+			return SP(array);
+		}
+
+		void writeString(string& output, string_view value) {
+			output += '"';
+			write_escaped_json(output, value);
+			output += '"';
+		}
+
+	public:
+		bool failed = false;
+
+		Decoder(string_view message) : s(message) {  // Message should outlive the decoder
+			if(char(readByte()) != magic) {
+				failed = true;
+
+				return;
+			}
+
+			usize count = readVarint();
+
+			if(count > s.size()) {
+				failed = true;
+
+				return;
+			}
+
+			tableStart = i;
+			strings.reserve(count);
+
+			for(usize j = 0; j < count && !failed; j++) {
+				strings.push_back(readBytes(readVarint()));
+			}
+
+			tableEnd = i;
+		}
+
+		NodeValue decode() {
+			Tag tag = Tag(readByte());
+
+			switch(tag) {
+				case Tag::Null:		return nullptr;
+				case Tag::False:	return false;
+				case Tag::True:		return true;
+				case Tag::Integer:	return int(readInteger());
+				case Tag::Double:	return readDouble();
+				case Tag::String:
+				case Tag::Interned:	return string(readString(tag));
+				case Tag::JSON:		return NodeValue(string(readString(tag)), true);
+				case Tag::Node:
+				case Tag::Array: {
+					if(++depth > depthLimit) {
+						failed = true;
+
+						return nullptr;
+					}
+
+					NodeValue value = tag == Tag::Node ? decodeNode() : decodeArray();
+
+					depth--;
+
+					return value;
+				}
+				default:
+					failed = true;
+
+					return nullptr;
+			}
+		}
+
+		/**
+		 * Decodes only given top-level fields of a root node, skipping the rest.
+		 */
+		NodeSP decode(const unordered_set<string_view>& keys) {
+			if(Tag(readByte()) != Tag::Node) {
+				failed = true;
+
+				return nullptr;
+			}
+
+			usize count;
+			usize end = readContainer(count);
+			NodeSP node = SP<Node>();
+
+			for(usize j = 0; j < count && !failed; j++) {
+				string_view key = readKey();
+
+				if(keys.contains(key)) {
+					(*node)[string(key)] = decode();
+				} else {
+					skip();
+				}
+			}
+
+			if(failed || i != end) {
+				return nullptr;
+			}
+
+			return node;
+		}
+
+		/**
+		 * Copies top-level fields of a root node except removed ones and appends added (replacing) ones, not decoding the values.
+		 */
+		optional<string> splice(const unordered_set<string_view>& removedKeys, const Node& addedFields) {
+			if(Tag(readByte()) != Tag::Node) {
+				return nullopt;
+			}
+
+			usize count;
+			usize end = readContainer(count);
+			vector<string_view> fields;
+
+			for(usize j = 0; j < count && !failed; j++) {
+				usize start = i;
+				string_view key = readKey();
+
+				skip();
+
+				if(!removedKeys.contains(key) && !addedFields.contains(string(key))) {
+					fields.push_back(s.substr(start, i-start));
+				}
+			}
+
+			if(failed || i != end) {
+				return nullopt;
+			}
+
+			Encoder encoder(strings.size());
+
+			for(auto& [key, value] : addedFields) {
+				encoder.encode(string_view(key));
+				encoder.encode(value);
+			}
+
+			string result(1, magic);
+
+			result.reserve(s.size()+encoder.table.size()+encoder.body.size()+16);
+			writeVarint(result, strings.size()+encoder.count());
+			result += s.substr(tableStart, tableEnd-tableStart);
+			result += encoder.table;
+			result += char(Tag::Node);
+
+			usize sizePosition = result.size();
+
+			result.append(4, '\0');
+			writeVarint(result, fields.size()+addedFields.size());
+
+			for(string_view field : fields) {
+				result += field;
+			}
+
+			result += encoder.body;
+
+			u32 size = result.size()-sizePosition-4;
+
+			memcpy(&result[sizePosition], &size, 4);
+
+			return result;
+		}
+
+		/**
+		 * Writes a value as JSON in the format of to_string(NodeValue), without building the nodes.
+		 */
+		void writeJSON(string& output) {
+			Tag tag = Tag(readByte());
+
+			switch(tag) {
+				case Tag::Null:		output += "null";								break;
+				case Tag::False:	output += "false";								break;
+				case Tag::True:		output += "true";								break;
+				case Tag::Integer:	write_number(output, int(readInteger()));		break;
+				case Tag::Double:	write_number(output, readDouble());				break;
+				case Tag::String:
+				case Tag::Interned:	writeString(output, readString(tag));			break;
+				case Tag::JSON:		output += readString(tag);						break;
+				case Tag::Node:
+				case Tag::Array: {
+					if(++depth > depthLimit) {
+						failed = true;
+
+						break;
+					}
+
+					usize count;
+					usize end = readContainer(count);
+
+					output += tag == Tag::Node ? '{' : '[';
+
+					for(usize j = 0; j < count && !failed; j++) {
+						if(j > 0) {
+							output += ", ";
+						}
+						if(tag == Tag::Node) {
+							writeString(output, readKey());
+							output += ": ";
+						}
+
+						writeJSON(output);
+					}
+
+					output += tag == Tag::Node ? '}' : ']';
+
+					if(i != end) {
+						failed = true;
+					}
+
+					depth--;
+				}
+				break;
+				default:
+					failed = true;
+				break;
+			}
+		}
+	};
+
+	NodeValue decode(string_view message) {
+		Decoder decoder(message);
+		NodeValue value = decoder.decode();
+
+		return decoder.failed ? NodeValue() : value;
+	}
+
+	NodeSP decode(string_view message, const unordered_set<string_view>& keys) {
+		Decoder decoder(message);
+
+		return decoder.failed ? nullptr : decoder.decode(keys);
+	}
+
+	optional<string> splice(string_view message, const unordered_set<string_view>& removedKeys, const Node& addedFields) {
+		Decoder decoder(message);
+
+		return decoder.failed ? nullopt : decoder.splice(removedKeys, addedFields);
+	}
+
+	optional<string> toJSON(string_view message) {
+		Decoder decoder(message);
+		string result;
+
+		if(!decoder.failed) {
+			result.reserve(message.size()*2);
+			decoder.writeJSON(result);
+		}
+		if(decoder.failed) {
+			return nullopt;
+		}
+
+		return result;
+	}
+};
@@ -21,9 +21,46 @@ struct Parser {
 		bool operator==(const Key& k) const = default;
 	};
 
+	/**
+	 * Inline rules are hashed by their shape up to a depth, and compared deeply on collisions.
+	 */
 	struct Hasher {
-		usize operator()(const Key& k) const {
-			return hash<usize>()(k.rule.index())^hash<usize>()(k.start);
+		usize operator()(const Rule& r) const {
+			return hashOf(r, 2);
+		}
+
+		static usize hashOf(const Rule& r, int depth) {
+			usize result = r.index();
+
+			auto combine = [&](usize value) {
+				result ^= value+0x9E3779B9+(result << 6)+(result >> 2);
+			};
+
+			switch(r.index()) {
+				case 0:
+					combine(hash<RuleRef>()(get<0>(r)));
+				break;
+				case 1:
+					for(const Grammar::Field& field : get<1>(r).get().fields) {
+						combine(hash<optional<string>>()(field.title));
+						combine(depth > 0 ? hashOf(field.rule, depth-1) : field.rule.index());
+					}
+				break;
+				case 2:
+					combine(hash<optional<string>>()(get<2>(r).get().patterns[0]));
+					combine(hash<optional<string>>()(get<2>(r).get().patterns[1]));
+				break;
+				case 3:
+					for(const Rule& rule : get<3>(r).get()) {
+						combine(depth > 0 ? hashOf(rule, depth-1) : rule.index());
+					}
+				break;
+				case 4:
+					combine(depth > 0 ? hashOf(get<4>(r).get().rule, depth-1) : get<4>(r).get().rule.index());
+				break;
+			}
+
+			return result;
 		}
 	};
 
@@ -35,6 +72,7 @@ struct Parser {
 		NodeValue value;
 		usize cleanTokens = 0,
 			  dirtyTokens = 0,
+			  examinedTokens = 0,  // From the start, including ones looked ahead at, so frames are kept by edits after them
 			  version = 0;
 		bool permitsDirt = false,  // Allow the frame parser to add a dirt into the value
 			 isInitialized = false,
@@ -83,6 +121,10 @@ struct Parser {
 			return start()+size();
 		}
 
+		usize examinedEnd() const {
+			return start()+examinedTokens;
+		}
+
 		// Should be used for non-proxy rules with own values and accumulative sizes before parsing.
 		// Rules that do just _set_ their value/size behave fine without that, but other can unintentionally mislead the "greater" check.
 		void clearResult() {
@@ -113,12 +155,20 @@ struct Parser {
 		}
 	};
 
+	struct Memo {
+		unordered_map<Rule, Frame, Hasher> frames;
+		usize examinedTokens = 0;  // Greatest of the frames
+	};
+
 	deque<Token> tokens;
-	unordered_map<Key, Frame, Hasher> cache;
-	unordered_map<usize, usize> versions;  // [Position : Version]
-	usize calls = 0;
+	deque<Memo> cache;  // [Position : Memo], moved along with tokens by edits
+	deque<usize> versions;  // [Position : Version], as well
+	unordered_map<const Node*, NodeSP> shiftedNodes;  // Since the last edit
+	usize calls = 0,
+		  examined = 0;  // End of tokens examined by frames being parsed
+	Interface::Coalescer progress;  // Partial trees
 
-	Parser(deque<Token> tokens) : tokens(filter(tokens, [](auto& t) { return !t.trivia; })) {}
+	Parser(const deque<Token>& tokens) : tokens(filter(tokens, [](auto& t) { return !t.trivia; })) {}
 
 	// ----------------------------------------------------------------
 
@@ -129,7 +179,7 @@ struct Parser {
 			return nullopt;
 		}
 
-		Rule& rule = Grammar::rules[ruleRef];
+		Rule& rule = Grammar::rules.at(ruleRef);  // Unlike operator[], safe to call from concurrent parsers
 		Frame& ruleFrame = parse({rule, refFrame.start()});
 
 		if(ruleFrame.value.type() == 5) {
@@ -166,7 +216,7 @@ struct Parser {
 				return nullopt;
 			}
 			if(nodeRule.normalize == 2) {
-				nodeFrame.value = node.begin()->second;
+				nodeFrame.value = NodeValue(node.begin()->second);  // Copied first, as the node is owned by the value being replaced
 
 				return nodeFrame;
 			}
@@ -194,6 +244,8 @@ struct Parser {
 		Token& token = position < tokens.size() ? tokens[position] : endOfFileToken;
 		string operands[2] = { token.type, token.value };
 
+		examined = max(examined, position+1);
+
 		#ifndef NDEBUG
 			println("Token at position ", position, ": ", token.type, ", value: ", token.value);
 		#endif
@@ -418,10 +470,22 @@ struct Parser {
 	}
 
 	Frame& parse(const Frame& templateFrame) {
-		Frame& frame = cache[templateFrame.key];
 		usize position = templateFrame.start();
+
+		if(position >= cache.size()) {
+			cache.resize(position+1);
+			versions.resize(position+1);
+		}
+
+		Memo& memo = cache[position];
+		Frame& frame = memo.frames[templateFrame.key.rule];
 		string title = templateFrame.title();
 
+		if(frame.isInitialized && frame.start() != position) {  // Moved by an edit, along with its tokens
+			frame.value = shift(frame.value, isize(position)-isize(frame.start()), shiftedNodes);
+			frame.key.start = position;
+		}
+
 		if(!frame.isInitialized) {
 			frame.key = templateFrame.key;
 			frame.isInitialized = true;
@@ -436,6 +500,8 @@ struct Parser {
 				println("[Parser] # ", repeat("| ", calls), title, " at ", position, ", recursion: ", frame.isCalled ? "yes" : "no", " => version: ", frame.version, ", clean: ", frame.cleanTokens, ", dirty: ", frame.dirtyTokens, ", value: ", to_string(frame.value));
 			#endif
 
+			examined = max(examined, frame.examinedEnd());  // Recursive frames have it from previous growths, that is what their values depend on
+
 			return frame;
 		}
 
@@ -443,25 +509,35 @@ struct Parser {
 			println("[Parser] # ", repeat("| ", calls++), title, " at ", position, " => old version: ", frame.version, " {");
 		#endif
 
+		usize outerExamined = examined;
+
+		examined = position;
 		frame.isCalled = true;
 
 		while(optional<Frame> newFrame = dispatch(frame)) {
+			frame.examinedTokens = max(frame.examinedTokens, examined-position);
+
 			if(!newFrame->greater(frame)) {
 				break;
 			}
 
 			frame.apply(*newFrame);
-			versions[position]++;
+
+			if(frame.isRecursive) {
+				versions[position]++;  // Frames at the position that have used the previous value are outdated, nothing else could use it
+			}
 
 			#ifndef NDEBUG
 				println("[Parser] # ", repeat("| ", calls), "- version: ", versions[position], ", clean: ", frame.cleanTokens, ", dirty: ", frame.dirtyTokens, ", value: ", to_string(frame.value));
 
-				Interface::sendToClients({
-					{"type", "notification"},
-					{"source", "parser"},
-					{"action", "parsed"},
-					{"tree", frame.value}
-				});
+				if(Interface::subscribed(Interface::Source::Parser, Interface::Detail::Progress)) {
+					progress.send({
+						{"type", "notification"},
+						{"source", "parser"},
+						{"action", "parsed"},
+						{"tree", frame.value}
+					});
+				}
 			#endif
 
 			if(!frame.isRecursive) {
@@ -469,8 +545,11 @@ struct Parser {
 			}
 		}
 
+		frame.examinedTokens = max(frame.examinedTokens, examined-position);
 		frame.version = versions[position];
 		frame.isCalled = false;
+		memo.examinedTokens = max(memo.examinedTokens, frame.examinedTokens);
+		examined = max(outerExamined, frame.examinedEnd());
 
 		#ifndef NDEBUG
 			println("[Parser] # ", repeat("| ", --calls), "} => new version: ", frame.version);
@@ -479,22 +558,175 @@ struct Parser {
 		return frame;
 	}
 
+	// ----------------------------------------------------------------
+
+	/**
+	 * Copy of the value with ranges moved by the offset.
+	 * Nodes are shared by frames and by trees given out before, so they are copied (once each) rather than changed.
+	 */
+	static NodeValue shift(const NodeValue& value, isize offset, unordered_map<const Node*, NodeSP>& shiftedNodes) {
+		if(value.type() == 6) {
+			const NodeArray& array = *value.get<NodeArraySP>();
+			auto shiftedArray = SP<NodeArray>();
+
+			shiftedArray->reserve(array.size());
+
+			for(const NodeValue& v : array) {
+				shiftedArray->push_back(shift(v, offset, shiftedNodes));
+			}
+
+			return shiftedArray;
+		}
+		if(value.type() != 5) {
+			return value;
+		}
+
+		const Node& node = *value.get<NodeSP>();
+		NodeSP& shiftedNode = shiftedNodes[&node];
+
+		if(shiftedNode) {
+			return shiftedNode;
+		}
+
+		shiftedNode = SP<Node>();
+
+		for(auto& [key, v] : node) {
+			if(key == "range" && v.type() == 5) {
+				Node range = *v.get<NodeSP>();
+
+				for(const char* bound : { "start", "end" }) {
+					if(range.contains(bound)) {
+						range[bound] = int(range.get(bound))+int(offset);
+					}
+				}
+
+				(*shiftedNode)[key] = range;
+			} else {
+				(*shiftedNode)[key] = shift(v, offset, shiftedNodes);
+			}
+		}
+
+		return shiftedNode;
+	}
+
+	/**
+	 * Prepares the cache for tokens from the start to be replaced. Frames before them are removed if they have examined
+	 * the tokens, all frames at a position are if some of the removed ones are left-recursive, as others may have used their values.
+	 * Frames after the tokens are moved along, updating their values when reused.
+	 */
+	void invalidate(usize start, usize removedCount, usize insertedCount) {
+		usize end = start+removedCount;
+
+		for(usize position = 0; position < min(start, cache.size()); position++) {
+			Memo& memo = cache[position];
+
+			if(position+memo.examinedTokens <= start) {
+				continue;
+			}
+
+			auto examines = [&](const Frame& frame) { return frame.examinedEnd() > start; };
+
+			if(any_of(memo.frames.begin(), memo.frames.end(), [&](auto& entry) { return entry.second.isRecursive && examines(entry.second); })) {
+				memo = Memo();
+
+				continue;
+			}
+
+			erase_if(memo.frames, [&](auto& entry) { return examines(entry.second); });
+			memo.examinedTokens = 0;
+
+			for(auto& [rule, frame] : memo.frames) {
+				memo.examinedTokens = max(memo.examinedTokens, frame.examinedTokens);
+			}
+		}
+
+		for(usize position = start; position < min(start+min(removedCount, insertedCount), cache.size()); position++) {
+			cache[position] = Memo();
+			versions[position] = 0;
+		}
+
+		usize middle = start+min(removedCount, insertedCount);  // Positions from here are removed or inserted
+
+		if(middle < cache.size()) {
+			if(removedCount > insertedCount) {
+				cache.erase(cache.begin()+middle, cache.begin()+min(end, cache.size()));
+				versions.erase(versions.begin()+middle, versions.begin()+min(end, versions.size()));
+			} else {
+				cache.insert(cache.begin()+middle, insertedCount-removedCount, Memo());
+				versions.insert(versions.begin()+middle, insertedCount-removedCount, 0);
+			}
+		}
+
+		shiftedNodes.clear();
+	}
+
+	/**
+	 * Replaces tokens from the start with inserted ones, so the next parse() reparses only what the edit affects.
+	 * Positions are of non-trivia tokens, as ranges in the tree are.
+	 * Edits out of the tokens range (e.g. sent by an editor out of sync) are rejected, leaving everything unchanged.
+	 */
+	bool edit(usize start, usize removedCount, const deque<Token>& insertedTokens) {
+		if(start > tokens.size() || removedCount > tokens.size()-start) {
+			println("[Parser] Edit of ", removedCount, " tokens at ", start, " is out of ", tokens.size(), " tokens /!\\");
+
+			return false;
+		}
+
+		deque<Token> inserted = filter(insertedTokens, [](auto& t) { return !t.trivia; });
+
+		invalidate(start, removedCount, inserted.size());
+		tokens.erase(tokens.begin()+start, tokens.begin()+start+removedCount);
+		tokens.insert(tokens.begin()+start, inserted.begin(), inserted.end());
+
+		return true;
+	}
+
+	/**
+	 * Edits current tokens into the new ones, replacing the range between their common prefix and suffix.
+	 * Tokens are compared by type and value, as nothing else is parsed.
+	 */
+	void update(const deque<Token>& newTokens) {
+		deque<Token> tokens = filter(newTokens, [](auto& t) { return !t.trivia; });
+		auto same = [](const Token& a, const Token& b) { return a.type == b.type && a.value == b.value; };
+		usize size = min(this->tokens.size(), tokens.size()),
+			  prefix = 0,
+			  suffix = 0;
+
+		while(prefix < size && same(this->tokens[prefix], tokens[prefix])) {
+			prefix++;
+		}
+		while(suffix < size-prefix && same(this->tokens[this->tokens.size()-1-suffix], tokens[tokens.size()-1-suffix])) {
+			suffix++;
+		}
+
+		invalidate(prefix, this->tokens.size()-prefix-suffix, tokens.size()-prefix-suffix);
+		this->tokens = move(tokens);
+	}
+
 	NodeSP parse() {
-		Interface::sendToClients({
-			{"type", "notification"},
-			{"source", "parser"},
-			{"action", "removeAll"},
-			{"moduleID", -1}
-		});
+		bool notify = Interface::subscribed(Interface::Source::Parser);
+
+		if(notify) {
+			Interface::sendToClients({
+				{"type", "notification"},
+				{"source", "parser"},
+				{"action", "removeAll"},
+				{"moduleID", -1}
+			});
+		}
 
 		NodeSP tree = parse({"module"}).value;
 
-		Interface::sendToClients({
-			{"type", "notification"},
-			{"source", "parser"},
-			{"action", "parsed"},
-			{"tree", tree}
-		});
+		progress.discard();  // Superseded by the final tree
+
+		if(notify) {
+			Interface::sendToClients({
+				{"type", "notification"},
+				{"source", "parser"},
+				{"action", "parsed"},
+				{"tree", tree}
+			});
+		}
 
 		return tree;
 	}
@@ -8,7 +8,7 @@ struct Parser {
 
 	deque<Token> tokens;
 
-	Parser(deque<Token> tokens) : tokens(filter(tokens, [](auto& t) { return !t.trivia; })) {}
+	Parser(const deque<Token>& tokens) : tokens(filter(tokens, [](auto& t) { return !t.trivia; })) {}
 
 	template<typename... Args>
 	NodeValue rules(const string& type, Args... args) {
@@ -3201,12 +3201,14 @@ struct Parser {
 		int value;
 
 		void update(int previous) {
-			if(value < previous) {  // Rollback global changes
-				Interface::sendToClients({
+			if(value < previous && Interface::subscribed(Interface::Source::Parser, Interface::Detail::Progress)) {  // Rollback global changes
+				self.rollbacks.send({
 					{"type", "notification"},
 					{"source", "parser"},
 					{"action", "removeAfterPosition"},
 					{"position", value-1}
+				}, [](Node& pending, const Node& node) {  // Deepest rollback covers the others
+					pending["position"] = min(pending.get<int>("position"), node.get<int>("position"));
 				});
 			}
 		}
@@ -3252,6 +3254,7 @@ struct Parser {
 		}
 	};
 
+	Interface::Coalescer rollbacks;
 	Position position = Position(*this, 0);
 
 	Token& token() {
@@ -3267,10 +3270,15 @@ struct Parser {
 	}
 
 	void report(int level, int position, const string& type, string string) {
+		if(!Interface::subscribed(Interface::Source::Parser)) {
+			return;
+		}
+
 		Location& location = tokens[position].location;
 
 		string = type+" -> "+string;
 
+		rollbacks.flush();  // Reports after a rollback shouldn't be removed by it
 		Interface::sendToClients({
 			{"type", "notification"},
 			{"source", "parser"},
@@ -3286,21 +3294,29 @@ struct Parser {
 	}
 
 	NodeSP parse() {
-		Interface::sendToClients({
-			{"type", "notification"},
-			{"source", "parser"},
-			{"action", "removeAll"},
-			{"moduleID", -1}
-		});
+		bool notify = Interface::subscribed(Interface::Source::Parser);
+
+		if(notify) {
+			Interface::sendToClients({
+				{"type", "notification"},
+				{"source", "parser"},
+				{"action", "removeAll"},
+				{"moduleID", -1}
+			});
+		}
 
 		NodeSP tree = rules("module");
 
-		Interface::sendToClients({
-			{"type", "notification"},
-			{"source", "parser"},
-			{"action", "parsed"},
-			{"tree", tree}
-		});
+		rollbacks.flush();
+
+		if(notify) {
+			Interface::sendToClients({
+				{"type", "notification"},
+				{"source", "parser"},
+				{"action", "parsed"},
+				{"tree", tree}
+			});
+		}
 
 		return tree;
 	}
@@ -1,24 +1,164 @@
 #pragma once
 
 #include "Std.cpp"
-
+#include "ThreadPool.cpp"
+
+/**
+ * Hierarchical timing wheel of 5 levels by 64 slots with millisecond ticks. Slots are intrusive lists
+ * of pooled task records, so scheduling, resetting and cancelling take constant time.
+ *
+ * Timer thread only advances the wheel, collecting due tasks in batches, which are executed by the shared
+ * thread pool, so a slow task can't delay others (heartbeats, request timeouts).
+ * Cancelled tasks are unlinked lazily, when their slot is reached.
+ *
+ * IDs are generation-tagged indexes of records, so IDs of finished and reused records are simply ignored.
+ *
+ * Completion of a task can be awaited, polled or continued through a handle, which has its own lock,
+ * so waiters never contend with the timer thread. Handles are created only on demand.
+ */
 class Scheduler {
 public:
 	using Task = function<void(usize)>;
 	using Clock = chrono::steady_clock;
 	using TimePoint = Clock::time_point;
 
-	Scheduler() {
+	class Completion {
+	public:
+		enum class State : u8 {
+			Pending,
+			Finished,
+			Cancelled
+		};
+
+		using Continuation = function<void(State)>;
+
+		Completion(Scheduler& scheduler, usize ID) : scheduler(scheduler), ID(ID) {}
+
+		usize taskID() const {
+			return ID;
+		}
+
+		State state() const {
+			lock_guard lock(mutex);
+
+			return state_;
+		}
+
+		bool done() const {
+			return state() != State::Pending;
+		}
+
+		State await() const {
+			awaitUntil(nullopt);
+
+			return state();
+		}
+
+		/**
+		 * Returns false if the task is still pending after the timeout.
+		 */
+		bool awaitFor(int timeoutMS) const {
+			return awaitUntil(Clock::now()+chrono::milliseconds(timeoutMS));
+		}
+
+		/**
+		 * Cancels the task, unless it's already finished or cancelled.
+		 */
+		void cancel() {
+			scheduler.cancel(ID);
+		}
+
+		/**
+		 * Continuations are called on a completing thread, or immediately if already done.
+		 */
+		void then(Continuation continuation) {
+			unique_lock lock(mutex);
+
+			if(state_ == State::Pending) {
+				continuations.push_back(move(continuation));
+
+				return;
+			}
+
+			lock.unlock();
+			continuation(state_);
+		}
+
+		void complete(State state) {
+			vector<Continuation> continuations;
+
+			{
+				lock_guard lock(mutex);
+
+				if(state_ != State::Pending) {
+					return;
+				}
+
+				state_ = state;
+				continuations.swap(this->continuations);
+			}
+
+			condition.notify_all();
+
+			for(Continuation& continuation : continuations) {
+				continuation(state);
+			}
+		}
+
+	private:
+		Scheduler& scheduler;
+		const usize ID;
+		mutable std::mutex mutex;
+		mutable condition_variable condition;
+		State state_ = State::Pending;
+		vector<Continuation> continuations;
+
+		/**
+		 * Pool workers run pending tasks meanwhile, as the task itself may be queued behind the waiter.
+		 */
+		bool awaitUntil(optional<TimePoint> deadline) const {
+			unique_lock lock(mutex);
+
+			while(state_ == State::Pending) {
+				if(deadline && Clock::now() >= *deadline) {
+					return false;
+				}
+
+				if(ThreadPool::isWorker()) {
+					lock.unlock();
+					bool helped = sharedThreadPool.runPending();
+					lock.lock();
+
+					if(!helped) {
+						condition.wait_until(lock, deadline ? min(*deadline, Clock::now()+chrono::milliseconds(1)) : Clock::now()+chrono::milliseconds(1));
+					}
+				} else
+				if(deadline) {
+					condition.wait_until(lock, *deadline);
+				} else {
+					condition.wait(lock);
+				}
+			}
+
+			return true;
+		}
+	};
+
+	using Handle = sp<Completion>;
+
+	Scheduler() : epoch(Clock::now()) {
+		heads.fill(none);
 		running = true;
 		worker = thread(&Scheduler::run, this);
 	}
 
 	~Scheduler() {
 		{
-			lock_guard lock(mutex);
+			unique_lock lock(mutex);
 
 			running = false;
 			condition.notify_all();
+			condition.wait(lock, [this] { return executingCount == 0; });  // Fired tasks refer to this scheduler
 		}
 
 		if(worker.joinable()) {
@@ -26,167 +166,394 @@ public:
 		}
 	}
 
-	usize schedule(Task task, int delayMS = 0, bool cycled = false, bool immediate = false) {
-		auto ST = SP<ScheduledTask>();
-
-		{
-			lock_guard lock(mutex);
-
-			ST->ID = nextID++;
+	/**
+	 * Handle requested here can't miss completion of a short task, unlike one requested by ID afterwards.
+	 */
+	usize schedule(Task task, int delayMS = 0, bool cycled = false, bool immediate = false, Handle* handle = nullptr) {
+		lock_guard lock(mutex);
+		u32 index = allocate();
+		Record& record = records[index];
 
-			if(task) {
-				ST->task = task;
-			} else {
-				println("[Scheduler] Adding empty task /!\\");
-			}
+		if(task) {
+			record.task = move(task);
+		} else {
+			println("[Scheduler] Adding empty task /!\\");
+		}
 
-			ST->delayMS = delayMS;
-			ST->cycled = cycled;
-			ST->time = Clock::now()+chrono::milliseconds(immediate ? 0 : delayMS);
+		record.delayMS = delayMS;
+		record.cycled = cycled;
+		record.expiry = tickOf(Clock::now())+(immediate ? 0 : max(delayMS, 0));
 
-			tasks[ST->ID] = ST;
-			queue.insert(ST);
-			condition.notify_one();
+		if(handle) {
+			*handle = record.completion = SP<Completion>(*this, record.ID);
 		}
 
-		return ST->ID;
+		link(index);
+		condition.notify_one();
+
+		return record.ID;
 	}
 
 	void reset(usize ID) {
 		lock_guard lock(mutex);
-		auto it = tasks.find(ID);
+		Record* record = find(ID);
 
-		if(it != tasks.end()) {
-			auto ST = it->second;
+		if(!record || record->cancelled) {
+			return;
+		}
+		if(record->linked) {
+			unlink(indexOf(ID));
+		}
 
-			if(ST->cancelled) {
-				return;
-			}
+		record->expiry = tickOf(Clock::now())+max(record->delayMS, 0);
 
-			queue.erase(ST);
+		link(indexOf(ID));
+		condition.notify_one();
+	}
 
-			ST->time = Clock::now()+chrono::milliseconds(ST->delayMS);
+	/**
+	 * Returns a completion handle of the task, or nil if it's already finished or cancelled.
+	 * Cycled tasks are completed only by cancellation.
+	 */
+	Handle handle(usize ID) {
+		lock_guard lock(mutex);
+		Record* record = find(ID);
 
-			queue.insert(ST);
-			condition.notify_one();
+		if(!record || record->cancelled) {
+			return nullptr;
+		}
+		if(!record->completion) {
+			record->completion = SP<Completion>(*this, ID);
 		}
+
+		return record->completion;
 	}
 
+	/**
+	 * Blocks until the task is finished or cancelled.
+	 */
 	void await(usize ID) {
-		sp<ScheduledTask> ST;
+		if(Handle handle = this->handle(ID)) {
+			handle->await();
+		}
+	}
+
+	void cancel(usize ID) {
+		Handle completion;
 
 		{
 			lock_guard lock(mutex);
-			auto it = tasks.find(ID);
+			Record* record = find(ID);
 
-			if(it == tasks.end()) {
+			if(!record || record->cancelled) {
 				return;
 			}
 
-			ST = it->second;
+			record->cancelled = true;
+			completion = record->completion;
 		}
 
-		unique_lock lock(mutex);
+		if(completion) {
+			completion->complete(Completion::State::Cancelled);
+		}
+	}
 
-		while(!ST->cancelled && !ST->finished) {
-			ST->condition.wait(lock);
+private:
+	static constexpr usize levelBits = 6,
+						   slotsCount = 1 << levelBits,
+						   levelsCount = 5;
+	static constexpr u32 none = u32(-1);
+
+	struct Record {
+		usize ID = 0;  // Generation << 32 | index, 0 if free
+		u32 generation = 0,
+			previous = none,
+			next = none;
+		u16 bucket = 0;  // Level*slotsCount+slot
+		Task task;
+		u64 expiry = 0;  // Tick
+		int delayMS = 0;
+		Handle completion;  // Created on demand
+		bool cycled = false,
+			 cancelled = false,
+			 linked = false,
+			 executing = false,
+			 rerun = false;  // Became due again while executing
+	};
+
+	std::mutex mutex;
+	deque<Record> records;  // Records are never moved, so pointers to them are stable
+	vector<u32> freeIndexes;
+	array<u32, levelsCount*slotsCount> heads;
+	array<u64, levelsCount> occupancy = {};  // Bitmaps of non-empty slots
+	u64 currentTick = 0;  // Last processed tick
+	const TimePoint epoch;
+	condition_variable condition;
+	atomic<bool> running;
+	thread worker;
+	usize executingCount = 0;
+
+	u64 tickOf(TimePoint time) const {
+		return chrono::ceil<chrono::milliseconds>(time-epoch).count();  // Expiries are rounded up, so tasks never fire early
+	}
+
+	static u32 indexOf(usize ID) {
+		return ID & u32(-1);
+	}
+
+	Record* find(usize ID) {
+		u32 index = indexOf(ID);
+
+		return ID && index < records.size() && records[index].ID == ID ? &records[index] : nullptr;
+	}
+
+	u32 allocate() {
+		u32 index;
+
+		if(!freeIndexes.empty()) {
+			index = freeIndexes.back();
+			freeIndexes.pop_back();
+		} else {
+			index = records.size();
+			records.emplace_back();
 		}
+
+		Record& record = records[index];
+
+		record.generation++;
+		record.ID = usize(record.generation) << 32 | index;
+		record.cycled = record.cancelled = record.linked = record.executing = record.rerun = false;
+
+		return index;
 	}
 
-	void cancel(usize ID) {
-		lock_guard lock(mutex);
-		auto it = tasks.find(ID);
+	void recycle(u32 index) {
+		Record& record = records[index];
 
-		if(it != tasks.end()) {
-			auto ST = it->second;
+		record.ID = 0;
+		record.task = nullptr;
+		record.completion = nullptr;
 
-			ST->cancelled = true;
-			ST->condition.notify_all();
+		freeIndexes.push_back(index);
+	}
 
-			tasks.erase(it);
+	/**
+	 * Places a record at the level of the highest tick digit (6 bits) that differs from the current tick,
+	 * so it's cascaded to the lower levels exactly when the current tick reaches its block.
+	 */
+	void link(u32 index) {
+		Record& record = records[index];
+		u64 expiry = max(record.expiry, currentTick+1),  // Ticks up to the current are already processed
+			difference = expiry^currentTick;
+		usize level = 0;
+
+		while(level < levelsCount-1 && difference >> levelBits*(level+1)) {
+			level++;
 		}
+
+		usize slot = expiry >> levelBits*level & (slotsCount-1);
+		u16 bucket = level*slotsCount+slot;
+
+		record.bucket = bucket;
+		record.previous = none;
+		record.next = heads[bucket];
+		record.linked = true;
+
+		if(heads[bucket] != none) {
+			records[heads[bucket]].previous = index;
+		}
+
+		heads[bucket] = index;
+		occupancy[level] |= u64(1) << slot;
 	}
 
-private:
-	struct ScheduledTask {
-		usize ID;
-		Task task;
-		TimePoint time;
-		int delayMS = 0;
-		bool cycled = false,
-			 cancelled = false,
-			 finished = false;
-		condition_variable condition;
-	};
+	void unlink(u32 index) {
+		Record& record = records[index];
+
+		if(record.previous != none) {
+			records[record.previous].next = record.next;
+		} else {
+			heads[record.bucket] = record.next;
+		}
+		if(record.next != none) {
+			records[record.next].previous = record.previous;
+		}
+		if(heads[record.bucket] == none) {
+			occupancy[record.bucket/slotsCount] &= ~(u64(1) << record.bucket%slotsCount);
+		}
+
+		record.linked = false;
+	}
+
+	/**
+	 * Returns the earliest tick after the current at which an occupied slot is reached (fired or cascaded).
+	 */
+	optional<u64> nextTick() const {
+		optional<u64> result;
 
-	struct Compare {
-		bool operator()(const sp<ScheduledTask> LHS, const sp<ScheduledTask> RHS) const {
-			if(LHS->time == RHS->time) {
-				return LHS->ID < RHS->ID;
+		for(usize level = 0; level < levelsCount; level++) {
+			u64 occupied = occupancy[level];
+
+			if(!occupied) {
+				continue;
 			}
 
-			return LHS->time < RHS->time;
+			usize shift = levelBits*level,
+				  index = currentTick >> shift & (slotsCount-1);
+			u64 following = index < slotsCount-1 ? occupied & ~u64(0) << (index+1) : 0,
+				period = u64(1) << (shift+levelBits),
+				tick = (currentTick & ~(period-1)) | (u64(countr_zero(following ?: occupied)) << shift);
+
+			if(tick <= currentTick) {
+				tick += period;
+			}
+			if(!result || tick < *result) {
+				result = tick;
+			}
 		}
-	};
 
-	std::mutex mutex;
-	unordered_map<usize, sp<ScheduledTask>> tasks;
-	set<sp<ScheduledTask>, Compare> queue;
-	condition_variable condition;
-	atomic<bool> running;
-	thread worker;
-	int nextID = 0;
+		return result;
+	}
+
+	void process(u64 tick, vector<u32>& due) {
+		currentTick = tick;
+
+		for(usize level = levelsCount-1; level > 0; level--) {
+			usize shift = levelBits*level;
+
+			if(!(tick & ((u64(1) << shift)-1))) {  // Block of the level starts at this tick
+				cascade(level*slotsCount+(tick >> shift & (slotsCount-1)), due);
+			}
+		}
+
+		cascade(tick & (slotsCount-1), due);
+	}
+
+	void cascade(usize bucket, vector<u32>& due) {
+		u32 index = heads[bucket];
+
+		heads[bucket] = none;
+		occupancy[bucket/slotsCount] &= ~(u64(1) << bucket%slotsCount);
+
+		while(index != none) {
+			Record& record = records[index];
+			u32 next = record.next;
+
+			record.linked = false;
+
+			if(record.executing) {
+				record.rerun = !record.cancelled && record.expiry <= currentTick;
+
+				if(!record.rerun && !record.cancelled) {
+					link(index);
+				}
+			} else
+			if(record.cancelled) {
+				recycle(index);
+			} else
+			if(record.expiry <= currentTick) {
+				due.push_back(index);
+			} else {
+				link(index);
+			}
+
+			index = next;
+		}
+	}
+
+	void dispatch(u32 index) {
+		Record* record = &records[index];
+
+		record->executing = true;
+		executingCount++;
+
+		sharedThreadPool.add([this, record, index] {
+			execute(record, index);
+		});
+	}
 
 	void run() {
 		prctl(PR_SET_NAME, "Scheduler", 0, 0, 0);
 
+		vector<u32> due;
+		unique_lock lock(mutex);
+
 		while(running) {
-			sp<ScheduledTask> ST;
-			unique_lock lock(mutex);
+			u64 now = chrono::floor<chrono::milliseconds>(Clock::now()-epoch).count();  // Only ticks that have fully arrived
+			optional<u64> next;
 
-			while(queue.empty() && running) {
-				condition.wait(lock);
+			while((next = nextTick()) && *next <= now) {
+				process(*next, due);
 			}
 
-			if(!running) {
-				break;
+			for(u32 index : due) {
+				dispatch(index);
 			}
 
-			auto it = queue.begin();
-			ST = *it;
+			due.clear();
 
-			if(ST->time > Clock::now()) {
-				condition.wait_until(lock, ST->time);
-
-				continue;
+			if(next) {
+				condition.wait_until(lock, epoch+chrono::milliseconds(*next));
+			} else {
+				condition.wait(lock);
 			}
+		}
+	}
 
-			queue.erase(it);
+	void execute(Record* record, u32 index) {
+		bool cancelled;
 
-			if(!ST->cancelled && ST->task) {
-				try {
-					lock.unlock(); // Allow tasks to call schedule/await/cancel
-					ST->task(ST->ID);
-					lock.lock();
-				} catch(const exception& e) {
-					println("[Scheduler] Exception in task ", ST->ID, ": ", e.what());
-				}
+		{
+			lock_guard lock(mutex);
+
+			cancelled = record->cancelled;
+		}
+
+		if(!cancelled && record->task) {  // Task and ID are not changed until the record is recycled
+			try {
+				record->task(record->ID);
+			} catch(const exception& e) {
+				println("[Scheduler] Exception in task ", record->ID, ": ", e.what());
 			}
+		}
+
+		Handle completion;
+
+		{
+			lock_guard lock(mutex);
+
+			record->executing = false;
 
-			ST->finished = true;
-			ST->condition.notify_all();
+			if(record->linked) {
+				// Was reset while executing, so it's already rescheduled
+			} else
+			if(record->cancelled) {
+				recycle(index);
+			} else
+			if(record->rerun) {
+				record->rerun = false;
 
-			if(!ST->cancelled && ST->cycled) {
-				ST->time = Clock::now()+chrono::milliseconds(ST->delayMS);
-				ST->finished = false;
+				dispatch(index);
+			} else
+			if(record->cycled) {
+				record->expiry = tickOf(Clock::now())+max(record->delayMS, 0);
 
-				queue.insert(ST);
+				link(index);
 				condition.notify_one();
 			} else {
-				tasks.erase(ST->ID);
+				completion = record->completion;
+
+				recycle(index);
 			}
+
+			executingCount--;
+			condition.notify_all();
+		}
+
+		if(completion) {
+			completion->complete(Completion::State::Finished);
 		}
 	}
 };
 
-static Scheduler sharedScheduler;
\ No newline at end of file
+static Scheduler sharedScheduler;
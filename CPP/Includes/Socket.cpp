@@ -2,6 +2,18 @@
 
 #include "Std.cpp"
 
+/**
+ * Length-prefixed message channel over a UNIX socket.
+ *
+ * Servers with reactor threads serve connections by epoll: sockets are non-blocking and edge-triggered,
+ * each owned by one reactor thread for its lifetime, so reading and buffering need no locks.
+ * Without reactor threads, a blocking thread is spawned per connection.
+ * Clients run a single reactor on the thread that starts them.
+ *
+ * Sent messages are queued per connection and written by gathering header and body pieces,
+ * so they are never concatenated, and partially written messages are continued where they stopped.
+ * Bodies are shared, so a message sent to many connections is stored once.
+ */
 class Socket {
 public:
 	enum class Mode {
@@ -9,10 +21,10 @@ public:
 		Client
 	};
 
-	using MessageHandler = function<void(int, const string&)>;
+	using MessageHandler = function<void(int, string_view)>;  // Message is valid only during the call
 	using ConnectionHandler = function<void(int)>;
 
-	Socket(filesystem::path path, Mode mode) : path(move(path)), mode(mode) {}
+	Socket(filesystem::path path, Mode mode, usize reactorsCount = 0) : path(move(path)), mode(mode), reactorsCount(mode == Mode::Server ? reactorsCount : 1) {}
 
 	~Socket() {
 		stop();
@@ -27,34 +39,107 @@ public:
 		disconnectionHandler = move(onDisconnect);
 	}
 
-	void send(int clientFD, const string& message) {
+	/**
+	 * Queues the message and writes as much of the queue as the socket accepts.
+	 *
+	 * Backed up reactor connections are flushed by their reactor when writable again, so senders never block
+	 * and messages queued meanwhile are written together. Senders on other threads flush them as well, as the reactor
+	 * may be busy handling a message. Connections without a reactor are waited for to drain.
+	 */
+	void send(int clientFD, string message) {
+		send(clientFD, SP<const string>(move(message)));
+	}
+
+	void send(int clientFD, sp<const string> message) {
 		if(!running) {
 			println(getLogPrefix(), "Can't send messages while is not running");
 
 			return;
 		}
 
-		u32 size = htonl(static_cast<u32>(message.size()));
-		string packet;
-		packet.resize(4+message.size());
-		memcpy(&packet[0], &size, 4);
-		memcpy(&packet[4], message.data(), message.size());
-		::send(clientFD, packet.data(), packet.size(), 0);
+		sp<Connection> connection = getConnection(clientFD);
+
+		if(!connection) {
+			println(getLogPrefix(), "Can't send to unknown connection ", clientFD);
+
+			return;
+		}
 
 		#ifndef NDEBUG
-			println(getLogPrefix(), "Sent", (mode == Mode::Server ? " to "+to_string(clientFD) : ""), ": ", message);
+			println(getLogPrefix(), "Sent", (mode == Mode::Server ? " to "+to_string(clientFD) : ""), ": ", *message);
 		#endif
+
+		lock_guard lock(connection->outboxMutex);
+
+		if(connection->closed) {
+			return;
+		}
+
+		usize size = message->size();
+		bool idle = connection->outbox.empty();
+
+		connection->outbox.push_back({htonl(static_cast<u32>(size)), move(message)});
+		connection->outboxSize += 4+size;
+
+		if(!idle && connection->reactive && connection->epollFD == reactorEpollFD) {
+			return;  // This reactor awaits writability
+		}
+
+		bool flushed = flush(*connection);
+
+		if(flushed && connection->reactive && !connection->outbox.empty()) {
+			watchWritability(*connection, true);
+		}
+
+		while(flushed && !connection->reactive && !connection->outbox.empty()) {
+			pollfd descriptor = {clientFD, POLLOUT, 0};
+
+			flushed = poll(&descriptor, 1, 5000) > 0 && flush(*connection);
+		}
+
+		if(!flushed) {
+			println(getLogPrefix(), "Failed to send to ", clientFD, ": ", strerror(errno));
+			shutdown(clientFD, SHUT_RDWR);  // Owning thread closes it on hang-up
+		}
 	}
 
-	void send(const string& message) {
+	/**
+	 * Message is taken as is to become a body of the outbound frame, so serialized messages shouldn't be copied.
+	 */
+	void send(string message) {
 		if(mode == Mode::Client) {
-			send(socketFD, message);
-		} else
+			send(socketFD, move(message));
+		} else {
+			send(getClientsFDs(), SP<const string>(move(message)));
+		}
+	}
+
+	/**
+	 * Fans out one shared message, framed separately per connection.
+	 */
+	template<typename FDs>
+	void send(const FDs& clientsFDs, sp<const string> message) {
 		for(int clientFD : clientsFDs) {
 			send(clientFD, message);
 		}
 	}
 
+	/**
+	 * Returns size of messages queued for the connection in bytes, so producers can throttle.
+	 */
+	usize getOutboxSize(int FD) const {
+		sp<Connection> connection = getConnection(FD);
+
+		return connection ? connection->outboxSize.load() : 0;
+	}
+
+	/**
+	 * Of the client's connection to the server.
+	 */
+	usize getOutboxSize() const {
+		return mode == Mode::Client ? getOutboxSize(socketFD) : 0;
+	}
+
 	void disconnect(int FD) {
 		if(mode == Mode::Client) {
 			if(FD == socketFD) {
@@ -66,8 +151,7 @@ public:
 			return;
 		}
 
-		shutdown(FD, SHUT_RDWR);
-		close(FD);
+		shutdown(FD, SHUT_RDWR);  // Owning thread closes it on hang-up
 	}
 
     void start() {
@@ -85,10 +169,16 @@ public:
 		if(running) {
 			running = false;
 			if(socketFD != -1) {
-				close(socketFD);
+				shutdown(socketFD, SHUT_RDWR);  // Interrupts blocking accept or read
+
+				if(mode == Mode::Server) {
+					close(socketFD);  // Client connection is closed by its reactor
+				}
+
 				socketFD = -1;
 			}
 			if(mode == Mode::Server) {
+				stopReactors();
 				unlink(path.c_str());
 			}
 		}
@@ -99,6 +189,16 @@ public:
 	}
 
 	unordered_set<int> getClientsFDs() const {
+		unordered_set<int> clientsFDs;
+
+		if(mode == Mode::Server) {
+			lock_guard lock(connectionsMutex);
+
+			for(auto& [FD, connection] : connections) {
+				clientsFDs.insert(FD);
+			}
+		}
+
 		return clientsFDs;
 	}
 
@@ -116,8 +216,205 @@ private:
 	ConnectionHandler connectionHandler,
 					  disconnectionHandler;
 
-	unordered_set<int> clientsFDs;
-	mutex clientsFDsMutex;
+	/**
+	 * Receive buffer that is read into directly and consumed by advancing an offset, so messages are handed out
+	 * as views in place. Remaining data is moved to the front only when space at the back runs out,
+	 * and the buffer grows to fit a pending message whole.
+	 */
+	struct ReadBuffer {
+		static constexpr usize chunkSize = 64*1024,
+							   retainedSize = 4*chunkSize;
+
+		string data;
+		usize start = 0,
+			  end = 0,
+			  missing = 0;  // Bytes of a pending message that are not received yet
+
+		usize size() const {
+			return end-start;
+		}
+
+		const char* begin() const {
+			return data.data()+start;
+		}
+
+		span<char> reserve() {
+			usize needed = max(missing, chunkSize);
+
+			if(data.size()-end < needed) {
+				if(start > 0) {
+					memmove(data.data(), data.data()+start, end-start);
+					end -= start;
+					start = 0;
+				}
+				if(data.size()-end < needed) {
+					data.resize_and_overwrite(max(data.size()*2, end+needed), [](char*, usize size) { return size; });
+				}
+			}
+
+			return span<char>(data.data()+end, data.size()-end);
+		}
+
+		void commit(usize count) {
+			end += count;
+		}
+
+		void consume(usize count) {
+			start += count;
+
+			if(start == end) {
+				start = end = 0;
+
+				if(data.size() > retainedSize) {
+					string().swap(data);  // Don't keep memory of a large message per idle connection
+				}
+			}
+		}
+	};
+
+	struct Frame {
+		u32 header;  // Size in network order
+		sp<const string> body;
+	};
+
+	/**
+	 * Read buffer belongs to the reading thread, outbox is shared by senders and the reactor under its mutex.
+	 */
+	struct Connection {
+		int FD,
+			epollFD;  // Of the owning reactor, -1 if none
+		bool reactive;  // Non-blocking, flushed by a reactor
+		ReadBuffer readBuffer;
+		mutex outboxMutex;
+		deque<Frame> outbox;
+		usize outboxOffset = 0;  // Written bytes of the front frame
+		atomic<usize> outboxSize = 0;
+		bool closed = false,
+			 registered = false,  // In the reactor
+			 watchingWritability = false;
+
+		Connection(int FD, int epollFD) : FD(FD), epollFD(epollFD), reactive(epollFD != -1) {}
+	};
+
+	unordered_map<int, sp<Connection>> connections;
+	mutable mutex connectionsMutex;
+
+	struct Reactor {
+		int epollFD = -1,
+			wakeFD = -1;
+		thread worker;
+	};
+
+	usize reactorsCount;
+	unique_ptr<Reactor[]> reactors;
+	atomic<usize> nextReactor = 0;
+
+	inline static thread_local int reactorEpollFD = -1;  // Of the reactor running on the thread
+
+	sp<Connection> getConnection(int FD) const {
+		lock_guard lock(connectionsMutex);
+		auto it = connections.find(FD);
+
+		return it != connections.end() ? it->second : nullptr;
+	}
+
+	/**
+	 * Connections owned by a reactor are made non-blocking at once, but watched only after the connection handler.
+	 */
+	sp<Connection> addConnection(int FD, Reactor* reactor) {
+		if(reactor) {
+			fcntl(FD, F_SETFL, fcntl(FD, F_GETFL)|O_NONBLOCK);
+		}
+
+		lock_guard lock(connectionsMutex);
+
+		return connections[FD] = SP<Connection>(FD, reactor ? reactor->epollFD : -1);
+	}
+
+	void closeConnection(int FD) {
+		sp<Connection> connection;
+
+		{
+			lock_guard lock(connectionsMutex);
+			auto it = connections.find(FD);
+
+			if(it != connections.end()) {
+				connection = move(it->second);
+				connections.erase(it);
+			}
+		}
+
+		if(disconnectionHandler) {
+			disconnectionHandler(FD);
+		}
+
+		if(connection) {
+			lock_guard lock(connection->outboxMutex);  // Senders holding the connection can't write to a reused FD
+
+			connection->closed = true;
+			connection->outbox.clear();
+			connection->outboxSize = 0;
+		}
+
+		close(FD);
+	}
+
+	/**
+	 * Writes queued frames without blocking, gathering pieces of up to 32 frames per call.
+	 * Returns false if the connection has failed. Outbox mutex should be held.
+	 */
+	bool flush(Connection& connection) {
+		while(!connection.outbox.empty()) {
+			array<iovec, 64> vectors;
+			usize count = 0,
+				  skip = connection.outboxOffset;
+
+			for(Frame& frame : connection.outbox) {
+				if(count+2 > vectors.size()) {
+					break;
+				}
+
+				for(auto [data, size] : {pair(reinterpret_cast<char*>(&frame.header), usize(4)), pair(const_cast<char*>(frame.body->data()), frame.body->size())}) {
+					if(skip >= size) {
+						skip -= size;
+
+						continue;
+					}
+
+					vectors[count++] = {data+skip, size-skip};
+					skip = 0;
+				}
+			}
+
+			msghdr message = {};
+			message.msg_iov = vectors.data();
+			message.msg_iovlen = count;
+
+			ssize_t bytes = sendmsg(connection.FD, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+			if(bytes < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+
+				return errno == EAGAIN || errno == EWOULDBLOCK;
+			}
+
+			usize written = connection.outboxOffset+bytes;
+
+			while(!connection.outbox.empty() && written >= 4+connection.outbox.front().body->size()) {
+				usize size = 4+connection.outbox.front().body->size();
+
+				written -= size;
+				connection.outboxSize -= size;
+				connection.outbox.pop_front();
+			}
+
+			connection.outboxOffset = written;
+		}
+
+		return true;
+	}
 
 	void startServer() {
 		socketFD = socket(AF_UNIX, SOCK_STREAM, 0);
@@ -149,18 +446,24 @@ private:
 		prctl(PR_SET_NAME, ("Server "+to_string(socketFD)).c_str(), 0, 0, 0);
 		println(getLogPrefix(), "Started at ", path);
 
+		if(createReactors()) {
+			for(usize i = 0; i < reactorsCount; i++) {
+				reactors[i].worker = thread(&Socket::runReactor, this, i);
+			}
+		}
+
 		while(running) {
 			int clientFD = accept(socketFD, nullptr, nullptr);
 			if(clientFD < 0) {
-				println(getLogPrefix(), "Accept failed");
+				if(running) {
+					println(getLogPrefix(), "Accept failed");
+				}
+
 				running = false;
 				break;
 			}
 
-			{
-				lock_guard lock(clientsFDsMutex);
-				clientsFDs.insert(clientFD);
-			}
+			sp<Connection> connection = addConnection(clientFD, reactors ? &reactors[nextReactor++%reactorsCount] : nullptr);
 
 			println(getLogPrefix(), "Client ", clientFD, " connected");
 
@@ -168,7 +471,11 @@ private:
 				connectionHandler(clientFD);
 			}
 
-			thread(&Socket::handleMessages, this, clientFD).detach();
+			if(connection->reactive) {
+				watch(*connection);
+			} else {
+				thread(&Socket::handleMessages, this, connection).detach();
+			}
 		}
 	}
 
@@ -194,24 +501,231 @@ private:
 		prctl(PR_SET_NAME, ("Client "+to_string(socketFD)).c_str(), 0, 0, 0);
 		println(getLogPrefix(), "Started and connected to server at ", path);
 
+		int FD = socketFD;
+		sp<Connection> connection = addConnection(FD, createReactors() ? &reactors[0] : nullptr);
+
 		if(connectionHandler) {
-			connectionHandler(socketFD);
+			connectionHandler(FD);
+		}
+
+		if(connection->reactive) {
+			watch(*connection);
+			runReactor(0);
+			stopReactors();
+
+			if(getConnection(FD)) {  // Stopped before the hang-up was handled
+				closeConnection(FD);
+			}
+		} else {
+			handleMessages(connection);
+		}
+	}
+
+	// ----------------------------------------------------------------
+
+	bool createReactors() {
+		if(!reactorsCount || reactors) {
+			return false;
 		}
 
-		handleMessages(socketFD);
+		reactors = make_unique<Reactor[]>(reactorsCount);
+
+		for(usize i = 0; i < reactorsCount; i++) {
+			Reactor& reactor = reactors[i];
+
+			reactor.epollFD = epoll_create1(EPOLL_CLOEXEC);
+			reactor.wakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+			epoll_event event = {};
+			event.events = EPOLLIN;
+			event.data.ptr = nullptr;
+
+			if(reactor.epollFD < 0 || reactor.wakeFD < 0 || epoll_ctl(reactor.epollFD, EPOLL_CTL_ADD, reactor.wakeFD, &event) < 0) {
+				println(getLogPrefix(), "Failed to create reactor, falling back to thread per connection");
+				stopReactors();
+
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void stopReactors() {
+		if(!reactors) {
+			return;
+		}
+
+		for(usize i = 0; i < reactorsCount; i++) {
+			Reactor& reactor = reactors[i];
+
+			if(reactor.wakeFD != -1) {
+				u64 one = 1;
+
+				::write(reactor.wakeFD, &one, sizeof(one));
+			}
+			if(reactor.worker.joinable()) {
+				if(reactor.worker.get_id() == this_thread::get_id()) {
+					reactor.worker.detach();  // Stopped by a handler, exits after the current events
+
+					continue;
+				}
+
+				reactor.worker.join();
+			}
+			if(reactor.epollFD != -1) {
+				close(reactor.epollFD);
+			}
+			if(reactor.wakeFD != -1) {
+				close(reactor.wakeFD);
+			}
+		}
+
+		reactors.reset();
+	}
+
+	void watch(Connection& connection) {
+		unique_lock lock(connection.outboxMutex);
+
+		connection.registered = true;
+
+		if(!updateEvents(connection, EPOLL_CTL_ADD)) {
+			println(getLogPrefix(), "Failed to watch ", connection.FD, ": ", strerror(errno));
+			lock.unlock();
+			closeConnection(connection.FD);
+		}
+	}
+
+	/**
+	 * Writability is watched only while the outbox is backed up, as otherwise every read by the peer
+	 * would wake the reactor. Rearming reports the current state, so draining in between isn't missed.
+	 * Outbox mutex should be held.
+	 */
+	void watchWritability(Connection& connection, bool watch) {
+		if(connection.watchingWritability != watch) {
+			connection.watchingWritability = watch;
+
+			if(connection.registered) {
+				updateEvents(connection, EPOLL_CTL_MOD);
+			}
+		}
 	}
 
-	void handleMessages(int FD) {
+	bool updateEvents(Connection& connection, int operation) {
+		epoll_event event = {};
+		event.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (connection.watchingWritability ? u32(EPOLLOUT) : u32(0));
+		event.data.ptr = &connection;
+
+		return epoll_ctl(connection.epollFD, operation, connection.FD, &event) == 0;
+	}
+
+	/**
+	 * Edge-triggered readiness is reported once per arrival, so sockets are read until drained.
+	 * Connections are only read by their reactor, so handlers of one connection are never called concurrently.
+	 */
+	void runReactor(usize index) {
+		if(mode == Mode::Server) {
+			prctl(PR_SET_NAME, ("SR "+to_string(index)).c_str(), 0, 0, 0);  // Server Reactor
+		}
+
+		int epollFD = reactors[index].epollFD;
+		array<epoll_event, 64> events;
+
+		reactorEpollFD = epollFD;
+
+		while(running) {
+			int count = epoll_wait(epollFD, events.data(), events.size(), -1);
+
+			if(count < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+
+				println(getLogPrefix(), "Reactor ", index, " failed: ", strerror(errno));
+
+				break;
+			}
+
+			for(int i = 0; i < count; i++) {
+				Connection* connection = static_cast<Connection*>(events[i].data.ptr);
+				u32 flags = events[i].events;
+
+				if(!connection) {
+					continue;  // Woken up to stop
+				}
+				if(flags & EPOLLOUT) {
+					lock_guard lock(connection->outboxMutex);
+
+					if(!flush(*connection)) {
+						shutdown(connection->FD, SHUT_RDWR);  // Reported as a hang-up
+					} else
+					if(connection->outbox.empty()) {
+						watchWritability(*connection, false);
+					}
+				}
+				if(!(flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+					continue;
+				}
+
+				int FD = connection->FD;
+				ReadBuffer& readBuffer = connection->readBuffer;
+				bool closed = false;
+
+				while(true) {
+					span<char> space = readBuffer.reserve();
+					ssize_t bytes = read(FD, space.data(), space.size());
+
+					if(bytes > 0) {
+						readBuffer.commit(bytes);
+						receive(*connection);
+
+						continue;
+					}
+					if(bytes == 0) {
+						println(getLogPrefix(), "Connection closed at ", FD);
+					} else
+					if(errno == EINTR) {
+						continue;
+					} else
+					if(errno == EAGAIN || errno == EWOULDBLOCK) {
+						break;
+					} else {
+						println(getLogPrefix(), "Read error on FD ", FD, ": ", strerror(errno));
+					}
+
+					closed = true;
+
+					break;
+				}
+
+				if(closed) {
+					epoll_ctl(epollFD, EPOLL_CTL_DEL, FD, nullptr);
+					closeConnection(FD);
+
+					if(mode == Mode::Client) {
+						running = false;
+					}
+				}
+			}
+		}
+
+		reactorEpollFD = -1;
+	}
+
+	// ----------------------------------------------------------------
+
+	void handleMessages(sp<Connection> connection) {
+		int FD = connection->FD;
+
 		if(mode == Mode::Server) {
 			prctl(PR_SET_NAME, ("SC "+to_string(FD)).c_str(), 0, 0, 0);  // Server Connection
 		}
 
-		string readBuffer;
-		constexpr usize maxSize = 10*1024*1024; // 10 MiB
+		ReadBuffer& readBuffer = connection->readBuffer;
 
 		while(running) {
-			char tmp[4096];
-			ssize_t bytes = read(FD, tmp, sizeof(tmp));
+			span<char> space = readBuffer.reserve();
+			ssize_t bytes = read(FD, space.data(), space.size());
 
 			if(bytes <= 0) {
 				if(bytes == 0) {
@@ -230,50 +744,56 @@ private:
 				break;
 			}
 
-			readBuffer.append(tmp, bytes);
+			readBuffer.commit(bytes);
+			receive(*connection);
+		}
 
-			while(readBuffer.size() >= 4) {
-				u32 size = 0;
-				memcpy(&size, readBuffer.data(), 4);
-				size = ntohl(size);
+		closeConnection(FD);
+	}
 
-				if(size == 0 || size > maxSize) {
-					println(getLogPrefix(), "Invalid message length (", size, "), discarding 4 bytes and resynchronizing.");
-					readBuffer.erase(0, 4);
+	/**
+	 * Handles complete messages at the beginning of the buffer, leaving an incomplete rest.
+	 */
+	void receive(Connection& connection) {
+		constexpr usize maxSize = 10*1024*1024; // 10 MiB
 
-					continue;
-				}
+		int FD = connection.FD;
+		ReadBuffer& readBuffer = connection.readBuffer;
 
-				if(readBuffer.size() < 4+size) {
-					break;  // Wait for a full message
-				}
+		readBuffer.missing = 0;
 
-				string message = readBuffer.substr(4, size);
+		while(readBuffer.size() >= 4) {
+			u32 size = 0;
+			memcpy(&size, readBuffer.begin(), 4);
+			size = ntohl(size);
 
-				#ifndef NDEBUG
-					println(getLogPrefix(), "Received", (mode == Mode::Server ? " from "+to_string(FD) : ""), ": ", message);
-				#endif
+			if(size == 0 || size > maxSize) {
+				println(getLogPrefix(), "Invalid message length (", size, "), discarding 4 bytes and resynchronizing.");
+				readBuffer.consume(4);
 
-				if(messageHandler) {
-					messageHandler(FD, message);
-				}
+				continue;
+			}
 
-				readBuffer.erase(0, 4+size);
+			if(readBuffer.size() < 4+size) {
+				readBuffer.missing = 4+size-readBuffer.size();
+
+				break;  // Wait for a full message
 			}
-		}
 
-		if(mode == Mode::Server) {
-			lock_guard lock(clientsFDsMutex);
-			clientsFDs.erase(FD);
-		}
+			string_view message(readBuffer.begin()+4, size);
 
-		if(disconnectionHandler) {
-			disconnectionHandler(FD);
-		}
+			#ifndef NDEBUG
+				println(getLogPrefix(), "Received", (mode == Mode::Server ? " from "+to_string(FD) : ""), ": ", message);
+			#endif
 
-		close(FD);
+			if(messageHandler) {
+				messageHandler(FD, message);
+			}
+
+			readBuffer.consume(4+size);
+		}
 	}
 };
 
 static sp<Socket> sharedServer,
-				  sharedClient;
\ No newline at end of file
+				  sharedClient;
@@ -2,11 +2,15 @@
 
 #include <algorithm>
 #include <any>
+#include <array>
 #include <arpa/inet.h>
 #include <atomic>
+#include <bit>
+#include <charconv>
 #include <chrono>
 #include <condition_variable>
 #include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <functional>
@@ -15,13 +19,20 @@
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <poll.h>
 #include <queue>
 #include <regex>
 #include <set>
+#include <span>
 #include <sstream>
 #include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
 #include <sys/prctl.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/un.h>
 #include <thread>
 #include <unistd.h>
@@ -30,6 +41,10 @@
 #include <variant>
 #include <vector>
 
+#if defined(__SSE2__)
+	#include <immintrin.h>
+#endif
+
 using namespace std;
 
 // ----------------------------------------------------------------
@@ -103,6 +118,18 @@ public:
 
 // ----------------------------------------------------------------
 
+/**
+ * Hash of string keyed unordered containers that lets them be searched by string views without owned copies of keys.
+ * Should be paired with `equal_to<>`.
+ */
+struct string_hash {
+	using is_transparent = void;
+
+	usize operator()(string_view string) const {
+		return hash<string_view>()(string);
+	}
+};
+
 template <typename Container, typename Predicate>
 bool some(const Container& container, Predicate predicate) {
 	return any_of(container.begin(), container.end(), predicate);
@@ -231,26 +258,104 @@ sp<T> any_spcast(const any& value) {
 	return nullptr;
 }
 
-optional<string> read_file(const filesystem::path& path) {
-	if(!filesystem::exists(path) || !filesystem::is_regular_file(path)) {
-		return nullopt;
+/**
+ * Contents of a source, viewed in place by lexers and caches, and owned by everything that keeps its artifacts.
+ * Regular files are mapped in memory instead of copied, others (pipes, devices) and small files are read.
+ * As with any mapping, a file shouldn't be truncated while in use.
+ */
+class SourceBuffer {
+	string contents;
+	const char* mapping = nullptr;
+	usize size = 0;
+
+public:
+	static constexpr usize mappingSizeThreshold = 16*1024;  // Smaller files are read faster than mapped
+
+	explicit SourceBuffer(string contents) : contents(move(contents)) {}
+
+	SourceBuffer(const char* mapping, usize size) : mapping(mapping), size(size) {}
+
+	SourceBuffer(const SourceBuffer&) = delete;
+
+	SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+	~SourceBuffer() {
+		if(mapping) {
+			munmap(const_cast<char*>(mapping), size);
+		}
+	}
+
+	string_view view() const {
+		return mapping ? string_view(mapping, size) : string_view(contents);
+	}
+};
+
+using SourceBufferSP = sp<const SourceBuffer>;
+
+SourceBufferSP read_source(const filesystem::path& path) {
+	int FD = open(path.c_str(), O_RDONLY|O_CLOEXEC);
+	struct stat status;
+
+	if(FD < 0) {
+		return nullptr;
+	}
+	if(fstat(FD, &status) < 0 || S_ISDIR(status.st_mode)) {
+		close(FD);
+
+		return nullptr;
+	}
+
+	bool regular = S_ISREG(status.st_mode);
+
+	if(regular && usize(status.st_size) >= SourceBuffer::mappingSizeThreshold) {
+		void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, FD, 0);
+
+		if(mapping != MAP_FAILED) {
+			close(FD);
+			madvise(mapping, status.st_size, MADV_SEQUENTIAL);  // Lexed once, front to back
+
+			return SP<SourceBuffer>(static_cast<const char*>(mapping), usize(status.st_size));
+		}
 	}
 
-	ifstream file(path, ios::in);
+	string contents(regular ? status.st_size+1 : 64*1024, '\0');  // Extra byte detects a file grown since fstat()
+	usize size = 0;
+
+	while(true) {
+		if(size == contents.size()) {
+			contents.resize(size*2);
+		}
+
+		ssize_t bytes = read(FD, contents.data()+size, contents.size()-size);
+
+		if(bytes < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			close(FD);
+
+			return nullptr;
+		}
+		if(bytes == 0) {
+			break;
+		}
 
-	if(!file.is_open()) {
-		return nullopt;
+		size += bytes;
 	}
 
-	ostringstream ss;
+	close(FD);
+	contents.resize(size);
 
-	ss << file.rdbuf();
+	return SP<SourceBuffer>(move(contents));
+}
 
-	if(file.fail()) {
-		return nullopt;
+optional<string> read_file(const filesystem::path& path) {
+	if(SourceBufferSP source = read_source(path)) {
+		return string(source->view());
 	}
 
-	return ss.str();
+	return nullopt;
 }
 
 template<typename... Args>
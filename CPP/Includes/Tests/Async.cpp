@@ -0,0 +1,119 @@
+// Async expressions share composites with the interpreter that started them: concurrent increments of one variable
+// and declarations in the same scope should neither lose updates nor race, and clean() should wait for expressions
+// still running on the thread pool. Meant to be run with ThreadSanitizer as well.
+//
+// Also reports speedups of async expressions over the same expressions evaluated in sequence. Identifiers are
+// resolved under the single heap lock (see `Interpreter::heapMutex()`), so expressions of them are expected to stay
+// near 1x regardless of the pool size, unlike expressions of literals.
+//
+// g++ -std=c++26 -O2 -DNDEBUG -march=native -I .. Async.cpp -o Async
+// g++ -std=c++26 -O1 -g -fsanitize=thread -I .. Async.cpp -o Async
+// ./Async [EXPRESSIONS COUNT] [POOL SIZE]
+
+#include "../Interpreter.cpp"
+
+using TypeSP = Interpreter::TypeSP;
+
+InterpreterSP interpret(const string& code) {
+	auto tokens = SP<const deque<Lexer::Token>>(Lexer(code).tokenize());
+	NodeSP tree = Parser(*tokens).parse();
+	auto interpreter = SP<Interpreter>(SP<SourceBuffer>(code), tokens, tree);
+
+	interpreter->addControlTransfer();
+	interpreter->addScope(interpreter->createNamespace("Global"));
+	interpreter->executeNodes(tree->get<NodeArraySP>("statements"));
+
+	return interpreter;
+}
+
+void awaitAll(const InterpreterSP& interpreter) {
+	deque<Interpreter::PromiseTypeSP> promises;
+
+	{
+		lock_guard lock(interpreter->heapMutex());
+
+		promises = interpreter->promises();
+	}
+
+	for(auto& promise : promises) {
+		promise->await();
+	}
+}
+
+/**
+ * Time of the expression evaluated a number of times in sequence over time of it evaluated asynchronously.
+ * Expression is lexed and parsed once, its node is shared by all evaluations.
+ */
+double speedup(const string& expression, usize count) {
+	string code = "var a = 1\nasync "+expression+"\n";
+	auto tokens = SP<const deque<Lexer::Token>>(Lexer(code).tokenize());
+	NodeSP tree = Parser(*tokens).parse();
+	NodeArray& statements = tree->get("statements");
+	NodeSP declaration = statements.at(0),
+		   async = statements.at(1);
+
+	auto seconds = [&](bool concurrently) {
+		auto interpreter = SP<Interpreter>(SP<SourceBuffer>(code), tokens, tree);
+
+		interpreter->addControlTransfer();
+		interpreter->addScope(interpreter->createNamespace("Global"));
+		interpreter->executeNode(declaration);
+
+		auto start = chrono::steady_clock::now();
+
+		for(usize i = 0; i < count; i++) {
+			interpreter->executeNode(concurrently ? async : async->get<NodeSP>("value"));
+		}
+
+		awaitAll(interpreter);
+
+		return chrono::duration<double>(chrono::steady_clock::now()-start).count();
+	};
+
+	return seconds(false)/seconds(true);
+}
+
+int main(int argc, char* argv[]) {
+	usize count = argc > 1 ? stoul(argv[1]) : 1000,
+		  poolSize = argc > 2 ? stoul(argv[2]) : 0;
+	usize failures = 0;
+	string code = "var a = 0\n";
+
+	for(usize i = 0; i < count; i++) {
+		code += "async a++\nvar b"+to_string(i)+" = a\n";
+	}
+
+	sharedThreadPool.start(poolSize ?: max(thread::hardware_concurrency(), 2u));
+
+	InterpreterSP interpreter = interpret(code);
+
+	awaitAll(interpreter);
+
+	TypeSP value = interpreter->scope()->access(Interpreter::AccessPath { "a" }, Interpreter::GetRequest());
+
+	if(!value || value->operator double() != count) {
+		println("Lost increments: ", value ? value->operator double() : -1, " instead of ", count);
+		failures++;
+	}
+
+	interpreter = interpret(code);
+	interpreter->clean();
+
+	if(interpreter->promises().size()) {
+		println("Pending promises after clean()");
+		failures++;
+	}
+
+	string identifiers = "a",
+		   literals = "1";
+
+	for(usize i = 0; i < 64; i++) {  // Operators are binary
+		identifiers = "("+identifiers+"+a)";
+		literals = "("+literals+"+1)";
+	}
+
+	println("Pool: ", sharedThreadPool.size(), ", speedup of identifiers: ", speedup(identifiers, count), "x, of literals: ", speedup(literals, count), "x");
+	println("Expressions: ", count, ", failures: ", failures);
+
+	return failures > 0;
+}
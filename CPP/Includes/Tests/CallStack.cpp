@@ -0,0 +1,89 @@
+// Scripts nested deeper than the native stack allows: execution should stop with a catchable (throw control transfer)
+// "Maximum call stack size exceeded" error, on the main thread and on a thread pool worker, at any optimization level,
+// including the constant folding pass of interpret().
+//
+// g++ -std=c++26 -O2 -DNDEBUG -march=native -I .. CallStack.cpp -o CallStack
+// ./CallStack [DEPTH]
+
+#include "../Interpreter.cpp"
+
+/**
+ * Parenthesized expressions around a literal, nested much deeper than a parser would allow.
+ * Nodes are kept in the list, so they are destroyed one by one rather than recursively.
+ */
+NodeSP nested(usize depth, vector<NodeSP>& nodes) {
+	auto range = [] { return SP<Node>(Node {{"start", 0}, {"end", 0}}); };
+	NodeSP node = SP<Node>(Node {{"type", "integerLiteral"}, {"range", range()}, {"value", "1"}});
+
+	nodes.push_back(node);
+
+	for(usize i = 0; i < depth; i++) {
+		node = SP<Node>(Node {{"type", "parenthesizedExpression"}, {"range", range()}, {"value", node}});
+		nodes.push_back(node);
+	}
+
+	return node;
+}
+
+bool exceeds(const NodeSP& tree, bool interpreted = false) {
+	auto interpreter = SP<Interpreter>(SP<SourceBuffer>(""), nullptr, tree);
+
+	interpreter->addControlTransfer();
+
+	if(interpreted) {
+		interpreter->interpret();
+	} else {
+		interpreter->executeNode(tree);
+	}
+
+	return interpreter->threw() && Interpreter::to_string(interpreter->controlTransfer().value).contains("Maximum call stack size exceeded");
+}
+
+int main(int argc, char* argv[]) {
+	usize depth = argc > 1 ? stoul(argv[1]) : 1000000;
+	vector<NodeSP> nodes;
+	NodeSP tree = nested(depth, nodes);
+	usize failures = 0;
+
+	if(!exceeds(tree)) {
+		println("Not stopped on the main thread");
+		failures++;
+	}
+
+	for(bool optimizations : { true, false }) {
+		Interface::preferences.optimizations = optimizations;
+
+		if(!exceeds(tree, true)) {
+			println("Not stopped when interpreted with optimizations ", optimizations ? "enabled" : "disabled");
+			failures++;
+		}
+	}
+
+	sharedThreadPool.start(1);
+
+	atomic<int> result = -1;
+
+	sharedThreadPool.add([&] { result = exceeds(tree); });
+
+	while(result < 0) {
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+
+	if(!result) {
+		println("Not stopped on a worker");
+		failures++;
+	}
+
+	if(exceeds(nested(16, nodes))) {
+		println("Shallow tree is stopped");
+		failures++;
+	}
+
+	for(NodeSP& node : nodes | views::reverse) {
+		(*node)["value"] = nullptr;
+	}
+
+	println("Depth: ", depth, ", stack limit: ", Interpreter::nodesStackLimit(), " B, failures: ", failures);
+
+	return failures > 0;
+}
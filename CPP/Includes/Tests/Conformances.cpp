@@ -0,0 +1,96 @@
+// Memoized conformance: values checked against a typed dictionary, as emplace() does, are computed once per distinct kind,
+// not once per value. Changing inherited types of a composite drops results that depended on them.
+// The table stays bounded with many live distinct types.
+//
+// g++ -std=c++26 -O2 -DNDEBUG -march=native -I .. Conformances.cpp -o Conformances
+// ./Conformances [VALUES COUNT]
+
+#include "../Interpreter.cpp"
+
+using TypeSP = Interpreter::TypeSP;
+using TypeID = Interpreter::TypeID;
+using PrimitiveType = Interpreter::PrimitiveType;
+using DictionaryType = Interpreter::DictionaryType;
+
+/**
+ * Accepts primitives, counting computations that were not memoized.
+ */
+struct CountingType : Interpreter::Type {
+	usize computations = 0;
+
+	CountingType() : Type(TypeID::Predefined) {
+		interned = true;
+	}
+
+	bool acceptsA(const TypeSP& type) override {
+		return cachedAcceptance(type, [&] {
+			computations++;
+
+			return type->ID == TypeID::Primitive;
+		});
+	}
+};
+
+int main(int argc, char* argv[]) {
+	usize count = argc > 1 ? stoul(argv[1]) : 100000;
+	auto valueType = SP<CountingType>();
+	usize failures = 0;
+
+	for(usize i = 0; i < count; i++) {
+		TypeSP value = i%2 ? PrimitiveType::get(int(i)) : PrimitiveType::get("Value "+to_string(i));
+
+		if(!value->conformsTo(valueType)) {
+			println("Value ", i, " does not conform");
+			failures++;
+		}
+	}
+
+	if(valueType->computations != 2) {
+		println("Computations for ", count, " values of 2 kinds: ", valueType->computations);
+		failures++;
+	}
+
+	auto dictionaryValueType = SP<CountingType>();
+	auto dictionary = SP<DictionaryType>(Interpreter::PredefinedEAnyTypeSP, dictionaryValueType, true);
+
+	for(usize i = 0; i < 1000; i++) {
+		dictionary->emplace(PrimitiveType::get(int(i)), PrimitiveType::get(i*0.5));
+	}
+
+	if(dictionaryValueType->computations != 2) {
+		println("Computations for ", dictionary->size(), " dictionary entries of 2 kinds: ", dictionaryValueType->computations);
+		failures++;
+	}
+
+	auto interpreter = SP<Interpreter>();
+	auto base = interpreter->createComposite("Base", Interpreter::CompositeTypeID::Class),
+		 derived = interpreter->createComposite("Derived", Interpreter::CompositeTypeID::Class);
+
+	if(base->acceptsA(derived)) {
+		println("Unrelated composite is accepted");
+		failures++;
+	}
+
+	derived->setInheritedTypes({ base });
+
+	if(!base->acceptsA(derived)) {
+		println("Stale conformance after changing inherited types");
+		failures++;
+	}
+
+	vector<TypeSP> types;
+
+	for(usize i = 0; i < Interpreter::conformancesLimit*2; i++) {
+		types.push_back(SP<CountingType>());
+		valueType->acceptsA(types.back());
+	}
+
+	if(Interpreter::conformances.size() > Interpreter::conformancesLimit) {
+		println("Conformances: ", Interpreter::conformances.size(), ", limit: ", Interpreter::conformancesLimit);
+		failures++;
+	}
+
+	println("Values: ", count, ", failures: ", failures);
+
+	return failures > 0;
+}
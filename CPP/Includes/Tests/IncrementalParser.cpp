@@ -0,0 +1,106 @@
+// Replays a typing session recorded as text edits over a source, reparsing after each edit incrementally
+// (Parser::update()) and from scratch. Trees are compared, times of reparses are reported.
+// Session retypes a line in the middle of the source, as a dashboard edit loop would send it, and a new line at its start.
+// Edits out of the tokens range should be rejected, leaving the tree as it is.
+//
+// g++ -std=c++26 -O2 -DNDEBUG -march=native -I .. IncrementalParser.cpp -o IncrementalParser
+// ./IncrementalParser [SOURCE PATH] [MAX EDITS, 0 - ALL]
+
+#include "../Parser.New.cpp"
+
+using Clock = chrono::steady_clock;
+
+struct Edit {
+	usize offset,
+		  removedCount;
+	string inserted;
+};
+
+vector<Edit> session(const string& code) {
+	vector<Edit> edits;
+	usize start = code.rfind('\n', code.size()/2)+1,
+		  end = code.find('\n', start);
+	string line = code.substr(start, end-start),
+		   newLine = "var typed = 'Line \\(1+2)'\n";
+
+	edits.push_back({ start, line.size(), "" });
+
+	for(usize i = 0; i < line.size(); i++) {
+		edits.push_back({ start+i, 0, string(1, line[i]) });
+	}
+	for(usize i = 0; i < newLine.size(); i++) {
+		edits.push_back({ i, 0, string(1, newLine[i]) });
+	}
+
+	return edits;
+}
+
+double median(vector<double> values) {
+	sort(values.begin(), values.end());
+
+	return values.empty() ? 0 : values[values.size()/2];
+}
+
+int main(int argc, char* argv[]) {
+	filesystem::path sourcePath = argc > 1 ? argv[1] : "../../../Resources/Examples/Activity Monitor";
+	usize maxEdits = argc > 2 ? stoul(argv[2]) : 0;
+	optional<string> source = read_file(sourcePath);
+
+	if(!source) {
+		println("Can't read ", sourcePath);
+
+		return 1;
+	}
+
+	string code = *source;
+	vector<Edit> edits = session(code);
+	Parser parser(Lexer(code).tokenize());
+	vector<double> incrementalMS,
+				   freshMS;
+	usize failures = 0;
+
+	parser.parse();
+
+	if(maxEdits > 0 && edits.size() > maxEdits) {
+		edits.resize(maxEdits);
+	}
+
+	for(const Edit& edit : edits) {
+		code.replace(edit.offset, edit.removedCount, edit.inserted);
+
+		deque<Lexer::Token> tokens = Lexer(code).tokenize();
+
+		Clock::time_point start = Clock::now();
+
+		parser.update(tokens);
+
+		NodeSP tree = parser.parse();
+
+		incrementalMS.push_back(chrono::duration<double, milli>(Clock::now()-start).count());
+		start = Clock::now();
+
+		NodeSP freshTree = Parser(tokens).parse();
+
+		freshMS.push_back(chrono::duration<double, milli>(Clock::now()-start).count());
+
+		if(!deep_equal(tree, freshTree)) {
+			println("Trees differ after edit at ", edit.offset, ": \"", escape_json(code.substr(edit.offset, 32)), "\"");
+			failures++;
+		}
+	}
+
+	NodeSP tree = parser.parse();
+
+	for(auto [start, removedCount] : { pair<usize, usize>(usize(-1), 0), pair<usize, usize>(0, usize(-1)), pair<usize, usize>(1, usize(-1)) }) {
+		if(parser.edit(start, removedCount, {}) || !deep_equal(parser.parse(), tree)) {
+			println("Edit of ", removedCount, " tokens at ", start, " is not rejected");
+			failures++;
+		}
+	}
+
+	println("Edits: ", edits.size(), ", failures: ", failures);
+	println("Incremental: median ", median(incrementalMS), " ms, max ", *max_element(incrementalMS.begin(), incrementalMS.end()), " ms");
+	println("From scratch: median ", median(freshMS), " ms, max ", *max_element(freshMS.begin(), freshMS.end()), " ms");
+
+	return failures > 0;
+}
@@ -0,0 +1,74 @@
+// Increments and decrements of variables: interned constants and values shared by other variables are copied-on-write,
+// so other variables (and literals) keep their values, while values held by a single variable are stepped in place.
+//
+// g++ -std=c++26 -O2 -DNDEBUG -march=native -I .. Increments.cpp -o Increments
+// ./Increments
+
+#include "../Interpreter.cpp"
+
+using TypeSP = Interpreter::TypeSP;
+using PrimitiveType = Interpreter::PrimitiveType;
+
+struct Case {
+	string code;
+	vector<pair<string, double>> expected;  // Variable : Value
+};
+
+InterpreterSP interpret(const string& code) {
+	auto tokens = SP<const deque<Lexer::Token>>(Lexer(code).tokenize());
+	NodeSP tree = Parser(*tokens).parse();
+	auto interpreter = SP<Interpreter>(SP<SourceBuffer>(code), tokens, tree);
+
+	interpreter->addControlTransfer();
+	interpreter->addScope(interpreter->createNamespace("Global"));
+	interpreter->executeNodes(tree->get<NodeArraySP>("statements"));
+
+	return interpreter;
+}
+
+optional<double> valueOf(const InterpreterSP& interpreter, const string& identifier) {
+	TypeSP value = interpreter->scope()->access(Interpreter::AccessPath { identifier }, Interpreter::GetRequest());
+
+	if(!value || value->ID != Interpreter::TypeID::Primitive) {
+		return nullopt;
+	}
+
+	return value->operator double();
+}
+
+int main() {
+	vector<Case> cases = {
+		{ "var a = 1\nvar b = 1\na++\n", { {"a", 2}, {"b", 1} } },
+		{ "var a = 1\nvar b = a\n++a\n", { {"a", 2}, {"b", 1} } },
+		{ "var a = 0\nvar b = 0\na--\n--a\n", { {"a", -2}, {"b", 0} } },
+		{ "var a = 2000\nvar b = a\na++\n", { {"a", 2001}, {"b", 2000} } },
+		{ "var a = 2000\na++\n++a\na--\n", { {"a", 2001} } },
+		{ "var a = 1023\na++\nvar b = 1023\n", { {"a", 1024}, {"b", 1023} } },
+		{ "var a = 0.5\nvar b = a\na++\n", { {"a", 1.5}, {"b", 0.5} } }
+	};
+	usize failures = 0;
+
+	for(const Case& c : cases) {
+		InterpreterSP interpreter = interpret(c.code);
+
+		for(auto& [identifier, expected] : c.expected) {
+			optional<double> value = valueOf(interpreter, identifier);
+
+			if(value != expected) {
+				println("Wrong value of ", identifier, ": ", value ? std::to_string(*value) : "nil", " instead of ", expected, " after:\n", c.code);
+				failures++;
+			}
+		}
+	}
+
+	for(int i : { -128, 0, 1, 2, 1023 }) {
+		if(PrimitiveType::get(i)->operator int() != i) {
+			println("Interned constant ", i, " was changed");
+			failures++;
+		}
+	}
+
+	println("Cases: ", cases.size(), ", failures: ", failures);
+
+	return failures > 0;
+}
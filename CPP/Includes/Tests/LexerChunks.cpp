@@ -0,0 +1,107 @@
+// Differential check of chunked lexing against sequential one, token for token, on example sources and generated ones
+// with states open across newlines: comments, strings, their expressions, statements, generic types and chains.
+// Chunk sizes are small, so chunks are split at (almost) every newline. Throughput is measured on a generated table.
+//
+// g++ -std=c++26 -O2 -DNDEBUG -march=native -I .. LexerChunks.cpp -o LexerChunks
+// ./LexerChunks [SOURCES DIRECTORY] [TABLE ROWS] [THREAD POOL SIZE, 0 - HARDWARE CONCURRENCY]
+
+#include "../Lexer.cpp"
+
+using Clock = chrono::steady_clock;
+
+string table(usize rows) {
+	string code = "var table = [\n";
+
+	for(usize i = 0; i < rows; i++) {
+		code += "\t["+to_string(i)+", 'Row \\("+to_string(i)+")', "+to_string(i)+".5, true, nil],\n";
+	}
+
+	return code+"]\n";
+}
+
+string hazards() {
+	string code;
+
+	for(usize i = 0; i < 64; i++) {
+		code +=
+			"var a"+to_string(i)+" = 1\n"
+			"/* block\ncomment /* nested\n*/ still */\n"
+			"*/ \tx\n"
+			"b = a .\nvar\n"
+			"c = a.\nd\n"
+			"'string\nwith newline \\\n"
+			"and \\(f(\ng)) expression'\n"
+			"if a < b {\n\tc = 1\n}\nelse {\n}\n"
+			"while x\n{\n}\n"
+			"x = y < z\nw > 1\n"
+			"// comment\n#\n1.\n5\n"
+			"e = 1 +\n2;\n;\n";
+	}
+
+	return code+"/* unterminated\nvar f\n'";
+}
+
+int main(int argc, char* argv[]) {
+	filesystem::path directory = argc > 1 ? argv[1] : "../../../Resources/Examples";
+	usize rows = argc > 2 ? stoul(argv[2]) : 50000;
+
+	sharedThreadPool.start(argc > 3 && stoul(argv[3]) > 0 ? stoul(argv[3]) : max(thread::hardware_concurrency(), 4u));
+
+	vector<pair<string, string>> sources = {
+		{ "table", table(256) },
+		{ "hazards", hazards() }
+	};
+	usize failures = 0;
+
+	for(const filesystem::directory_entry& entry : filesystem::directory_iterator(directory)) {
+		optional<string> code = read_file(entry.path());
+
+		if(code && entry.path().extension() != ".js") {
+			sources.push_back({ entry.path().filename(), *code });
+		}
+	}
+
+	for(auto& [name, code] : sources) {
+		Lexer sequential(code);
+
+		sequential.chunkSize = 0;
+
+		string expected = Lexer::to_string(sequential.tokenize());
+
+		for(usize chunkSize : { 1, 7, 64, 4096 }) {
+			Lexer chunked(code);
+
+			chunked.chunkSize = chunkSize;
+
+			if(Lexer::to_string(chunked.tokenize()) != expected) {
+				println("Tokens differ: ", name, ", chunk size: ", chunkSize);
+				failures++;
+			}
+		}
+	}
+
+	string code = table(rows);
+	Lexer sequential(code),
+		  chunked(code);
+
+	sequential.chunkSize = 0;
+
+	Clock::time_point start = Clock::now();
+	usize count = sequential.tokenize().size();
+	double sequentialSeconds = chrono::duration<double>(Clock::now()-start).count();
+
+	start = Clock::now();
+
+	if(chunked.tokenize().size() != count) {
+		println("Tokens of the table differ in count");
+		failures++;
+	}
+
+	double chunkedSeconds = chrono::duration<double>(Clock::now()-start).count();
+
+	println("Sources: ", sources.size(), ", thread pool size: ", sharedThreadPool.size(), ", failures: ", failures);
+	println("Table: ", code.size(), " bytes, ", count, " tokens");
+	println("Sequential: ", sequentialSeconds, " s, chunked: ", chunkedSeconds, " s, speedup: ", sequentialSeconds/chunkedSeconds);
+
+	return failures > 0;
+}
@@ -0,0 +1,86 @@
+// Loading time of a generated program of many modules, one by one versus with ModuleLoader on the thread pool.
+// Modules are copies of a source, each importing the next one in short chains, all imported by the main module.
+// Loaded modules are checked to come after their imports.
+//
+// g++ -std=c++26 -O2 -DNDEBUG -march=native -I .. ModuleLoader.cpp -o ModuleLoader
+// ./ModuleLoader [SOURCE PATH] [MODULES COUNT] [THREAD POOL SIZE, 0 - HARDWARE CONCURRENCY]
+
+#include "../Modules.cpp"
+
+using Clock = chrono::steady_clock;
+
+/**
+ * Sources differ by a comment, so artifacts are never shared between modules or programs.
+ */
+filesystem::path generate(const filesystem::path& directory, const string& source, usize count, const string& salt) {
+	filesystem::remove_all(directory);
+	filesystem::create_directories(directory);
+
+	string main;
+
+	for(usize i = 0; i < count; i++) {
+		string imports = i%4 != 3 && i+1 < count ? "import M"+to_string(i+1)+"\n" : "";
+
+		ofstream(directory/("M"+to_string(i))) << "// "+salt+" "+to_string(i)+"\n"+imports+source;
+		main += "import M"+to_string(i)+"\n";
+	}
+
+	ofstream(directory/"Main") << "// "+salt+"\n"+main;
+
+	return directory/"Main";
+}
+
+int main(int argc, char* argv[]) {
+	filesystem::path sourcePath = argc > 1 ? argv[1] : "../../../Resources/Examples/Foundation";
+	usize count = argc > 2 ? stoul(argv[2]) : 16;
+	optional<string> source = read_file(sourcePath);
+
+	if(!source) {
+		println("Can't read ", sourcePath);
+
+		return 1;
+	}
+
+	sharedThreadPool.start(argc > 3 ? stoul(argv[3]) : 0);
+
+	filesystem::path directory = filesystem::temp_directory_path()/"RootServer.modules";
+	filesystem::path mainPath = generate(directory, *source, count, "sequential");
+	Clock::time_point start = Clock::now();
+
+	for(const filesystem::directory_entry& entry : filesystem::directory_iterator(directory)) {
+		sharedArtifacts.get(read_source(entry.path()));
+	}
+
+	double sequentialSeconds = chrono::duration<double>(Clock::now()-start).count();
+
+	mainPath = generate(directory, *source, count, "concurrent");
+	start = Clock::now();
+
+	vector<Module> modules = ModuleLoader().load(mainPath);
+	double concurrentSeconds = chrono::duration<double>(Clock::now()-start).count();
+	unordered_set<string> loaded;
+	usize failures = 0;
+
+	for(const Module& module : modules) {
+		for(const filesystem::path& importPath : module.imports) {
+			if(!loaded.contains(importPath.string())) {
+				println("Module is loaded before its import: ", module.path, " -> ", importPath);
+				failures++;
+			}
+		}
+
+		loaded.insert(module.path.string());
+	}
+
+	if(modules.size() != count+1 || modules.back().path.filename() != "Main") {
+		println("Loaded ", modules.size(), " modules instead of ", count+1, ", the main one is not the last");
+		failures++;
+	}
+
+	filesystem::remove_all(directory);
+
+	println("Modules: ", count+1, ", thread pool size: ", argc > 3 && stoul(argv[3]) > 0 ? stoul(argv[3]) : thread::hardware_concurrency(), ", failures: ", failures);
+	println("Sequential: ", sequentialSeconds, " s, concurrent: ", concurrentSeconds, " s, speedup: ", sequentialSeconds/concurrentSeconds);
+
+	return failures > 0;
+}
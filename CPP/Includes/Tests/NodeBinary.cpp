@@ -0,0 +1,100 @@
+// Binary encoding of IPC messages: round trips through decoding, routed fields and JSON transcoding, and rejection of
+// malformed input. Truncated messages and containers nested deeper than the decoder reads (as a peer could send them
+// to the router) should fail decoding instead of crashing.
+//
+// g++ -std=c++26 -O2 -DNDEBUG -march=native -I .. NodeBinary.cpp -o NodeBinary
+// ./NodeBinary [DEPTH]
+
+#include "../NodeBinary.cpp"
+
+/**
+ * Message of a node with receiverTokens set to arrays nested to the depth, written by hand,
+ * as the encoder is recursive. Array of depth k (with null in the innermost) takes 6k+1 bytes.
+ */
+string nested(usize depth) {
+	string message(1, NodeBinary::magic);
+	auto writeContainer = [&](NodeBinary::Tag tag, u32 size) {
+		message += char(tag);
+		message.append(reinterpret_cast<const char*>(&size), 4);
+		NodeBinary::writeVarint(message, 1);
+	};
+
+	NodeBinary::writeVarint(message, 1);
+	NodeBinary::writeVarint(message, 14);
+	message += "receiverTokens";
+
+	writeContainer(NodeBinary::Tag::Node, 3+6*depth+1);
+	message += char(NodeBinary::Tag::Interned);
+	NodeBinary::writeVarint(message, 0);
+
+	for(usize k = depth; k > 0; k--) {
+		writeContainer(NodeBinary::Tag::Array, 6*k-4);
+	}
+
+	message += char(NodeBinary::Tag::Null);
+
+	return message;
+}
+
+int main(int argc, char* argv[]) {
+	usize depth = argc > 1 ? stoul(argv[1]) : 40000;
+	usize failures = 0;
+	vector<NodeValue> values = {
+		Node {
+			{"receiver", "server"},
+			{"type", "notification"},
+			{"action", "heartbeat"},
+			{"senderTokens", NodeArray { "=", "<input", ">output" }},
+			{"encodings", NodeArray { "binary" }}
+		},
+		NodeParser(R"({"receiver": "client", "type": "request", "requestID": "r\"1é😀", "timeout": -30, "scale": 1.5e-3, "receiverFDs": [3, 4], "nested": [[[{}]], {"a": null}]})").parse(),
+		Node {
+			{"type", "notification"},
+			{"tokens", NodeValue("[{\"type\": \"identifier\"}]", true)},
+			{"text", string(100, 'x')}
+		}
+	};
+
+	for(const NodeValue& value : values) {
+		string message = NodeBinary::encode(value);
+		NodeSP routed = NodeBinary::decode(message, {"receiver", "receiverFDs"});
+
+		if(!deep_equal(NodeBinary::decode(message), value, true)) {
+			println("Round trip has failed: ", to_string(value));
+			failures++;
+		}
+		if(NodeBinary::toJSON(message) != to_string(value)) {
+			println("Transcoding has failed: ", to_string(value));
+			failures++;
+		}
+		if(!routed || !deep_equal(routed->get("receiver", nullptr), value.get<NodeSP>()->get("receiver", nullptr)) || routed->contains("type")) {
+			println("Routed fields are wrong: ", routed ? to_string(*routed) : "null");
+			failures++;
+		}
+
+		for(usize size : { usize(1), message.size()/2, message.size()-1 }) {
+			string_view truncated = string_view(message).substr(0, size);
+
+			if(!NodeBinary::decode(truncated).empty() || NodeBinary::decode(truncated, {"receiver"}) || NodeBinary::toJSON(truncated)) {
+				println("Truncated message was accepted: ", size, " of ", message.size(), " bytes");
+				failures++;
+			}
+		}
+	}
+
+	string deep = nested(depth),
+		   shallow = nested(1000);
+
+	if(!NodeBinary::decode(deep).empty() || NodeBinary::decode(deep, {"receiverTokens"}) || NodeBinary::toJSON(deep)) {
+		println("Nesting of ", depth, " was accepted");
+		failures++;
+	}
+	if(NodeBinary::decode(shallow).empty() || !NodeBinary::decode(shallow, {"receiverTokens"}) || !NodeBinary::toJSON(shallow)) {
+		println("Nesting of 1000 was rejected");
+		failures++;
+	}
+
+	println("Messages: ", values.size(), ", depth: ", depth, " (", deep.size(), " bytes), failures: ", failures);
+
+	return failures > 0;
+}
@@ -0,0 +1,97 @@
+// Round-trip check and throughput of NodeParser on dashboard traffic: heartbeats and lexer/parser notifications
+// built from example sources, as routed between the server and clients.
+//
+// g++ -std=c++26 -O2 -DNDEBUG -march=native -I .. NodeParser.cpp -o NodeParser
+// ./NodeParser [SOURCES DIRECTORY] [REPEATS]
+
+#include "../Parser.New.cpp"
+
+using Clock = chrono::steady_clock;
+
+vector<string> corpus(const filesystem::path& directory) {
+	vector<string> messages;
+
+	for(const filesystem::directory_entry& entry : filesystem::directory_iterator(directory)) {
+		optional<string> code = read_file(entry.path());
+
+		if(!code || entry.path().extension() == ".js") {
+			continue;
+		}
+
+		deque<Lexer::Token> tokens = Lexer(*code).tokenize();
+		NodeSP tree = Parser(tokens).parse();
+
+		messages.push_back(Node {
+			{"type", "notification"},
+			{"source", "lexer"},
+			{"action", "tokenized"},
+			{"tokens", NodeValue(Lexer::to_string(tokens), true)},
+			{"senderFD", 7},
+			{"senderProcessID", 4321}
+		});
+		messages.push_back(Node {
+			{"type", "notification"},
+			{"source", "parser"},
+			{"action", "parsed"},
+			{"tree", tree},
+			{"senderFD", 7},
+			{"senderProcessID", 4321}
+		});
+	}
+
+	messages.push_back(Node {
+		{"receiver", "server"},
+		{"type", "notification"},
+		{"action", "heartbeat"},
+		{"senderTokens", NodeArray { "=", "<input", ">output" }},
+		{"encodings", NodeArray { "binary" }}
+	});
+	messages.push_back(R"({"receiver": "client", "type": "request", "requestID": "r\"1é😀", "timeout": -30, "scale": 1.5e-3, "big": 12345678901, "receiverFDs": [3, 4], "nested": [[[{}]], {"a": null}]})");
+
+	return messages;
+}
+
+int main(int argc, char* argv[]) {
+	filesystem::path directory = argc > 1 ? argv[1] : "../../../Resources/Examples";
+	usize repeats = argc > 2 ? stoul(argv[2]) : 20;
+	vector<string> messages = corpus(directory);
+	usize bytes = 0,
+		  failures = 0;
+
+	for(const string& message : messages) {
+		NodeParser parser(message);
+		NodeValue value = parser.parse();
+		string serialized = to_string(value);
+
+		bytes += message.size();
+
+		if(!parser.error.empty() || !deep_equal(NodeParser(serialized).parse(), value, true) || to_string(NodeParser(serialized).parse()).size() != serialized.size()) {
+			println("Round trip has failed: ", parser.error, "\n", message.substr(0, 256));
+			failures++;
+		}
+
+		for(usize size : { usize(0), message.size()/3, message.size()-1 }) {
+			NodeParser truncated(string_view(message).substr(0, size));
+
+			if(!truncated.parse().empty() || truncated.error.empty()) {
+				println("Truncated message was accepted: ", size, " of ", message.size(), " bytes");
+				failures++;
+			}
+		}
+	}
+
+	Clock::time_point start = Clock::now();
+
+	for(usize i = 0; i < repeats; i++) {
+		for(const string& message : messages) {
+			NodeParser(message).parse();
+		}
+	}
+
+	double seconds = chrono::duration<double>(Clock::now()-start).count();
+
+	println("Messages: ", messages.size(), ", ", bytes, " bytes, failures: ", failures);
+	println("Throughput: ", bytes*repeats/seconds/1e6, " MB/s");
+
+	return failures > 0;
+}
@@ -0,0 +1,106 @@
+// Task latency of the scheduler while long tasks occupy the thread pool: clients send cycled heartbeats, which reset
+// cycled server timeouts, as in RootServer (7.5 s and 15 s, scaled down). A server timeout that fires twice in a row
+// without a heartbeat in between disconnects a client, so it's a missed deadline. Reports lateness of heartbeats.
+//
+// g++ -std=c++26 -O2 -DNDEBUG -march=native -I .. SchedulerLatency.cpp -o SchedulerLatency
+// ./SchedulerLatency [CLIENTS] [POOL SIZE] [LONG TASKS] [SECONDS] [HEARTBEAT MS]
+
+#include "../Scheduler.cpp"
+
+using Clock = chrono::steady_clock;
+
+struct Client {
+	std::mutex mutex;
+	bool unresponsive = false,
+		 disconnected = false;
+	usize timeoutTaskID = 0;
+	Clock::time_point lastHeartbeat;
+	vector<double> latenesses;  // Milliseconds
+};
+
+int main(int argc, char* argv[]) {
+	usize clientsCount = argc > 1 ? stoul(argv[1]) : 1000,
+		  poolSize = argc > 2 ? stoul(argv[2]) : 4,
+		  longTasksCount = argc > 3 ? stoul(argv[3]) : poolSize-1;
+	double seconds = argc > 4 ? stod(argv[4]) : 3;
+	int heartbeatMS = argc > 5 ? stoi(argv[5]) : 75,  // 7.5 s / 100
+		timeoutMS = heartbeatMS*2;
+	atomic<usize> longRuns = 0;
+
+	sharedThreadPool.start(poolSize);
+
+	vector<usize> longTaskIDs;
+
+	for(usize i = 0; i < longTasksCount; i++) {  // Each run blocks a worker for several deadlines
+		longTaskIDs.push_back(sharedScheduler.schedule([&](usize) {
+			this_thread::sleep_for(chrono::milliseconds(timeoutMS*4));
+			longRuns++;
+		}, 0, true, true));
+	}
+
+	deque<Client> clients(clientsCount);
+	vector<usize> heartbeatTaskIDs;
+	Clock::time_point start = Clock::now();
+
+	for(Client& client : clients) {
+		client.lastHeartbeat = start;
+		client.timeoutTaskID = sharedScheduler.schedule([&client](usize) {
+			lock_guard lock(client.mutex);
+
+			if(client.unresponsive) {
+				client.disconnected = true;
+			}
+
+			client.unresponsive = true;
+		}, timeoutMS, true);
+	}
+
+	for(Client& client : clients) {
+		heartbeatTaskIDs.push_back(sharedScheduler.schedule([&client, heartbeatMS](usize) {
+			Clock::time_point now = Clock::now();
+			lock_guard lock(client.mutex);
+
+			client.latenesses.push_back(max(chrono::duration<double, milli>(now-client.lastHeartbeat).count()-heartbeatMS, 0.0));
+			client.lastHeartbeat = now;
+			client.unresponsive = false;
+			sharedScheduler.reset(client.timeoutTaskID);
+		}, heartbeatMS, true, true));
+	}
+
+	this_thread::sleep_for(chrono::duration<double>(seconds));
+
+	for(usize ID : longTaskIDs) {
+		sharedScheduler.cancel(ID);
+	}
+	for(Client& client : clients) {
+		sharedScheduler.cancel(client.timeoutTaskID);
+	}
+	for(usize ID : heartbeatTaskIDs) {
+		sharedScheduler.cancel(ID);
+	}
+
+	this_thread::sleep_for(chrono::milliseconds(timeoutMS*4));  // Runs that are still executing refer to the locals
+
+	vector<double> latenesses;
+	usize disconnected = 0;
+
+	for(Client& client : clients) {
+		lock_guard lock(client.mutex);
+
+		latenesses.insert(latenesses.end(), client.latenesses.begin()+1, client.latenesses.end());  // First heartbeat is immediate
+		disconnected += client.disconnected;
+	}
+
+	sort(latenesses.begin(), latenesses.end());
+
+	auto percentile = [&](double p) {
+		return latenesses.empty() ? 0 : latenesses[min<usize>(latenesses.size()*p, latenesses.size()-1)];
+	};
+
+	println("Clients: ", clientsCount, ", pool: ", poolSize, ", long tasks: ", longTasksCount, " (", longRuns.load(), " runs of ", timeoutMS*4, " ms)");
+	println("Heartbeats: ", latenesses.size(), " every ", heartbeatMS, " ms, deadline ", timeoutMS, " ms");
+	println("Lateness: p50 ", percentile(0.5), " ms, p99 ", percentile(0.99), " ms, max ", percentile(1), " ms");
+	println("Missed deadlines: ", disconnected);
+
+	return disconnected > 0;
+}
@@ -0,0 +1,271 @@
+// Load generator for the socket server: opens N local clients, each keeping a window of messages in flight,
+// and reports throughput and latencies.
+//
+// By default clients talk to an own echo server. Given a path of a running dashboard (RootServer -d -t = -s PATH -sts THREADS),
+// clients are paired by tokens and notify each other through its router instead.
+//
+// g++ -std=c++26 -O2 -DNDEBUG -I .. SocketLoad.cpp -o SocketLoad
+// ./SocketLoad [CLIENTS] [MESSAGES PER CLIENT] [MESSAGE SIZE] [SOCKET THREADS, 0 - THREAD PER CONNECTION] [DASHBOARD SOCKET PATH]
+
+#include <barrier>
+#include <semaphore>
+
+#include "../Socket.cpp"
+
+using Clock = chrono::steady_clock;
+
+constexpr usize window = 16,
+				stampSize = 20;  // Decimal nanoseconds
+
+bool writeAll(int FD, const char* data, usize size) {
+	while(size > 0) {
+		ssize_t bytes = ::send(FD, data, size, MSG_NOSIGNAL);
+
+		if(bytes <= 0) {
+			if(bytes < 0 && errno == EINTR) {
+				continue;
+			}
+
+			return false;
+		}
+
+		data += bytes;
+		size -= bytes;
+	}
+
+	return true;
+}
+
+bool readAll(int FD, char* data, usize size) {
+	while(size > 0) {
+		ssize_t bytes = read(FD, data, size);
+
+		if(bytes <= 0) {
+			if(bytes < 0 && errno == EINTR) {
+				continue;
+			}
+
+			return false;
+		}
+
+		data += bytes;
+		size -= bytes;
+	}
+
+	return true;
+}
+
+string frame(const string& message) {
+	u32 length = htonl(message.size());
+
+	return string(reinterpret_cast<char*>(&length), 4)+message;
+}
+
+bool readFrame(int FD, string& message) {
+	u32 length;
+
+	if(!readAll(FD, reinterpret_cast<char*>(&length), 4)) {
+		return false;
+	}
+
+	message.resize(ntohl(length));
+
+	return readAll(FD, message.data(), message.size());
+}
+
+/**
+ * Messages carry the time of sending, as raw bytes to the echo server or as a JSON string through the router.
+ */
+struct Load {
+	optional<usize> pair;  // Router mode
+	usize size;
+
+	string packet() const {
+		if(!pair) {
+			return frame(string(size, 'x'));
+		}
+
+		string message = "{\"receiver\":\"client\",\"type\":\"notification\",\"action\":\"load\",\"sentAt\":\""+string(stampSize, '0')+"\",\"padding\":\"\"}";
+
+		message.insert(message.size()-2, string(size > message.size() ? size-message.size() : 0, 'x'));
+
+		return frame(message);
+	}
+
+	void stamp(string& packet) const {
+		i64 now = Clock::now().time_since_epoch().count();
+
+		if(!pair) {
+			memcpy(&packet[4], &now, sizeof(now));
+		} else {
+			string digits = to_string(now);
+
+			memcpy(&packet[packet.find("sentAt")+9+stampSize-digits.size()], digits.data(), digits.size());
+		}
+	}
+
+	i64 stampOf(const string& message) const {
+		i64 then = 0;
+
+		if(!pair) {
+			memcpy(&then, message.data(), sizeof(then));
+		} else {
+			usize position = message.find("\"sentAt\":");  // Router reserializes messages, possibly with spaces
+
+			if(position != string::npos && (position = message.find('"', position+9)) != string::npos) {
+				then = stoll(message.substr(position+1, stampSize));
+			}
+		}
+
+		return then;
+	}
+};
+
+/**
+ * Returns latencies in nanoseconds, or nothing if the connection has failed.
+ */
+optional<vector<i64>> runClient(const filesystem::path& path, usize messagesCount, const Load& load, barrier<>& registered) {
+	int FD = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path)-1);
+
+	if(FD < 0 || connect(FD, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		registered.arrive_and_drop();
+
+		return nullopt;
+	}
+
+	if(load.pair) {
+		string heartbeat = frame("{\"receiver\":\"server\",\"type\":\"notification\",\"action\":\"heartbeat\",\"senderTokens\":[\"=load"+to_string(*load.pair)+"\"]}");
+
+		writeAll(FD, heartbeat.data(), heartbeat.size());
+	}
+
+	registered.arrive_and_wait();
+	registered.arrive_and_wait();  // Started
+
+	string packet = load.packet(),
+		   response;
+	vector<i64> latencies;
+	counting_semaphore<window> slots(window);  // Messages in flight
+	atomic<bool> failed = false;
+
+	latencies.reserve(messagesCount);
+
+	// Responses are read concurrently, so large messages can't deadlock both sides on full buffers
+	thread reader([&] {
+		while(latencies.size() < messagesCount) {
+			if(!readFrame(FD, response)) {
+				failed = true;
+				slots.release();
+
+				return;
+			}
+
+			latencies.push_back(Clock::now().time_since_epoch().count()-load.stampOf(response));
+			slots.release();
+		}
+	});
+
+	for(usize sent = 0; sent < messagesCount && !failed; sent++) {
+		slots.acquire();
+		load.stamp(packet);
+
+		if(failed || !writeAll(FD, packet.data(), packet.size())) {
+			failed = true;
+			shutdown(FD, SHUT_RDWR);
+
+			break;
+		}
+	}
+
+	reader.join();
+	close(FD);
+
+	if(failed) {
+		return nullopt;
+	}
+
+	return latencies;
+}
+
+int main(int argc, char* argv[]) {
+	usize clientsCount = argc > 1 ? stoul(argv[1]) : 100,
+		  messagesCount = argc > 2 ? stoul(argv[2]) : 10000,
+		  size = max<usize>(argc > 3 ? stoul(argv[3]) : 64, sizeof(i64)),
+		  threadsCount = argc > 4 ? stoul(argv[4]) : 2;
+	bool routed = argc > 5;
+	filesystem::path path = routed ? argv[5] : "/tmp/RootServer.load.sock";
+	optional<Socket> server;
+	thread serverThread;
+
+	if(routed) {
+		clientsCount -= clientsCount%2;  // Every client needs a partner
+	} else {
+		server.emplace(path, Socket::Mode::Server, threadsCount);
+		server->setMessageHandler([&](int FD, string_view message) {
+			server->send(FD, string(message));
+		});
+
+		serverThread = thread([&] { server->start(); });
+	}
+
+	while(!filesystem::exists(path)) {
+		this_thread::sleep_for(10ms);
+	}
+
+	vector<optional<vector<i64>>> results(clientsCount);
+	vector<thread> clients;
+	barrier registered(clientsCount+1);
+
+	for(usize i = 0; i < clientsCount; i++) {
+		clients.emplace_back([&, i] {
+			results[i] = runClient(path, messagesCount, Load(routed ? optional<usize>(i/2) : nullopt, size), registered);
+		});
+	}
+
+	registered.arrive_and_wait();
+
+	if(routed) {
+		this_thread::sleep_for(200ms);  // Heartbeats are processed, so no message is sent before its receiver has a route
+	}
+
+	Clock::time_point start = Clock::now();
+
+	registered.arrive_and_wait();
+
+	for(thread& client : clients) {
+		client.join();
+	}
+
+	double seconds = chrono::duration<double>(Clock::now()-start).count();
+	vector<i64> latencies;
+	usize failures = 0;
+
+	for(optional<vector<i64>>& result : results) {
+		if(result) {
+			latencies.insert(latencies.end(), result->begin(), result->end());
+		} else {
+			failures++;
+		}
+	}
+
+	sort(latencies.begin(), latencies.end());
+
+	auto percentile = [&](double p) {
+		return latencies.empty() ? 0 : latencies[min<usize>(latencies.size()*p, latencies.size()-1)]/1000.0;
+	};
+
+	println();
+	println("Clients: ", clientsCount, " (", failures, " failed), messages: ", latencies.size(), " of ", size, " bytes, ", (routed ? "routed by "+path.string() : "socket threads: "+to_string(threadsCount)));
+	println("Throughput: ", usize(latencies.size()/seconds), " messages/s in ", seconds, " s");
+	println("Latency, us: p50 ", percentile(0.5), ", p99 ", percentile(0.99), ", max ", percentile(1));
+
+	if(server) {
+		server->stop();
+		serverThread.join();
+	}
+
+	return 0;
+}
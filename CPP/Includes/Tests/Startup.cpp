@@ -0,0 +1,66 @@
+// Startup latency of scripts with cold and warm artifacts cache: reading, lexing and parsing versus loading
+// from the cache directory, as a fresh process would. Warm artifacts are checked to be the same as cold ones.
+//
+// g++ -std=c++26 -O2 -DNDEBUG -march=native -I .. Startup.cpp -o Startup
+// ./Startup [SOURCES DIRECTORY] [REPEATS] [CACHE DIRECTORY]
+
+#include "../Artifacts.cpp"
+
+using Clock = chrono::steady_clock;
+
+/**
+ * Returns milliseconds of the median launch.
+ */
+double launch(const filesystem::path& path, usize repeats, bool warm, ArtifactSP& artifact) {
+	vector<double> durations;
+
+	for(usize i = 0; i < repeats; i++) {
+		if(!warm) {
+			filesystem::remove_all(*Interface::preferences.cachePath);
+		}
+
+		Clock::time_point start = Clock::now();
+		artifact = Artifacts().get(read_source(path));  // Own memory cache per launch
+		durations.push_back(chrono::duration<double, milli>(Clock::now()-start).count());
+	}
+
+	sort(durations.begin(), durations.end());
+
+	return durations[durations.size()/2];
+}
+
+int main(int argc, char* argv[]) {
+	filesystem::path directory = argc > 1 ? argv[1] : "../../../Resources/Examples";
+	usize repeats = argc > 2 ? stoul(argv[2]) : 5;
+	Interface::preferences.cachePath = argc > 3 ? argv[3] : "/tmp/RootServer.startup.cache";
+	usize failures = 0;
+	double coldTotal = 0,
+		   warmTotal = 0;
+
+	for(const filesystem::directory_entry& entry : filesystem::directory_iterator(directory)) {
+		if(!entry.is_regular_file() || entry.path().extension() == ".js") {
+			continue;
+		}
+
+		ArtifactSP cold,
+				   warm;
+		double coldDuration = launch(entry.path(), repeats, false, cold),
+			   warmDuration = launch(entry.path(), repeats, true, warm);
+
+		coldTotal += coldDuration;
+		warmTotal += warmDuration;
+
+		if(Lexer::to_string(*cold->tokens) != Lexer::to_string(*warm->tokens) || !deep_equal(cold->tree, warm->tree)) {
+			println("Warm artifact differs from cold: ", entry.path());
+			failures++;
+		}
+
+		println(entry.path().filename(), ": ", cold->code->view().size(), " bytes, cold ", coldDuration, " ms, warm ", warmDuration, " ms");
+	}
+
+	filesystem::remove_all(*Interface::preferences.cachePath);
+
+	println("Total: cold ", coldTotal, " ms, warm ", warmTotal, " ms, failures: ", failures);
+
+	return failures > 0;
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "Std.cpp"
+
+/**
+ * Work-stealing pool: each worker owns a deque, taking its own tasks from the back (LIFO, cache-warm)
+ * and stealing from the front of others when idle. Tasks added by outside threads are spread round-robin.
+ */
+class ThreadPool {
+public:
+	using Task = function<void()>;
+
+	ThreadPool() {}
+
+	~ThreadPool() {
+		{
+			lock_guard lock(mutex);
+
+			running = false;
+			condition.notify_all();
+		}
+
+		for(thread& worker : workers) {
+			if(worker.joinable()) {
+				worker.join();
+			}
+		}
+	}
+
+	/**
+	 * Spawns workers, once. Size of 0 means hardware concurrency.
+	 * Pool is started with a default size on first use if not started explicitly.
+	 */
+	void start(usize size = 0) {
+		call_once(started, [&] {
+			size = max<usize>(size ?: thread::hardware_concurrency(), 1);
+			running = true;
+			queues = make_unique<WorkerQueue[]>(size);
+			queuesCount = size;
+
+			for(usize i = 0; i < size; i++) {
+				workers.emplace_back(&ThreadPool::run, this, i);
+			}
+		});
+	}
+
+	void add(Task task) {
+		if(!task) {
+			println("[ThreadPool] Adding empty task /!\\");
+
+			return;
+		}
+
+		start();
+
+		usize index = ownIndex();
+
+		if(index == usize(-1)) {
+			index = nextQueue++%queuesCount;
+		}
+
+		{
+			lock_guard lock(queues[index].mutex);
+
+			queues[index].tasks.push_back(move(task));
+		}
+
+		pending++;
+
+		{
+			lock_guard lock(mutex);  // Waiters check pending under this lock, so the notification can't be lost
+		}
+
+		condition.notify_one();
+	}
+
+	/**
+	 * Runs one pending task on the calling thread, if any.
+	 *
+	 * Workers that are blocked (e.g. awaiting a result of another task) should help
+	 * with the queues instead, so the pool can't be exhausted by waiting tasks.
+	 */
+	bool runPending() {
+		if(queuesCount == 0) {
+			return false;
+		}
+
+		usize index = ownIndex();
+		Task task = take(index != usize(-1) ? index : 0);
+
+		if(!task) {
+			return false;
+		}
+
+		execute(task);
+
+		return true;
+	}
+
+	static bool isWorker() {
+		return workerPool;
+	}
+
+	usize size() const {
+		return queuesCount;
+	}
+
+private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		deque<Task> tasks;
+	};
+
+	once_flag started;
+	std::mutex mutex;  // Idle workers only
+	condition_variable condition;
+	unique_ptr<WorkerQueue[]> queues;
+	atomic<usize> queuesCount = 0;  // Set before workers are spawned, unlike the size of workers, so they can read it while others are spawned, read without locks by helping threads
+	vector<thread> workers;
+	atomic<usize> pending = 0,
+				  nextQueue = 0;
+	atomic<bool> running = false;
+	inline static thread_local ThreadPool* workerPool = nullptr;
+	inline static thread_local usize workerIndex = 0;
+
+	usize ownIndex() const {
+		return workerPool == this ? workerIndex : usize(-1);
+	}
+
+	Task take(usize index) {
+		usize size = queuesCount;
+
+		for(usize i = 0; i < size; i++) {
+			WorkerQueue& queue = queues[(index+i)%size];
+			lock_guard lock(queue.mutex);
+
+			if(queue.tasks.empty()) {
+				continue;
+			}
+
+			Task task;
+
+			if(i == 0) {
+				task = move(queue.tasks.back());
+				queue.tasks.pop_back();
+			} else {
+				task = move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+
+			pending--;
+
+			return task;
+		}
+
+		return nullptr;
+	}
+
+	void run(usize index) {
+		prctl(PR_SET_NAME, "ThreadPool", 0, 0, 0);
+
+		workerPool = this;
+		workerIndex = index;
+
+		while(true) {
+			if(Task task = take(index)) {
+				execute(task);
+
+				continue;
+			}
+
+			unique_lock lock(mutex);
+
+			condition.wait(lock, [this] { return pending > 0 || !running; });
+
+			if(!running && pending == 0) {
+				break;
+			}
+		}
+	}
+
+	static void execute(Task& task) {
+		try {
+			task();
+		} catch(const exception& e) {
+			println("[ThreadPool] Exception in task: ", e.what());
+		}
+	}
+};
+
+static ThreadPool sharedThreadPool;
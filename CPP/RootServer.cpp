@@ -1,10 +1,9 @@
 #include "Interpreter.cpp"
+#include "Modules.cpp"
 #include "Scheduler.cpp"
 
 namespace RootServer {
-	optional<string> code;
-	optional<deque<Lexer::Token>> tokens;
-	optional<NodeSP> tree;
+	ArtifactSP artifact;  // Of the latest code, lexed and parsed by separate actions
 	mutex interpreterMutex;
 
 	struct Request {
@@ -12,86 +11,299 @@ namespace RootServer {
 		unordered_set<int> receiverFDs,           // Empty - any, non-empty - specific
 						   receiverProcessesIDs;
 		int timeout = 0;  // 0 - Infinity, 1+ - seconds
-		optional<usize> timeoutTaskID;
+		Scheduler::Handle timeoutCompletion;  // Cancelled when the request is unregistered
 		bool reauthReceiver = false,
 			 multipleResponses = false;
 		unordered_map<int, bool> responderFDs;  // [Client FD : Responded]
 	};
 
-	struct Client {
+	/**
+	 * Identity of a client that messages are routed by.
+	 */
+	struct Route {
 		int FD = 0,
 			processID = 0;
+		unordered_set<string> tokens;
+		bool binaryEncoding = false;  // Negotiated by a client, otherwise it receives JSON
+		Interface::Subscriptions subscriptions = {};  // Set by heartbeats, clients that don't declare them receive everything
+		bool declaresSubscriptions = false;  // And are announced the subscriptions of others
+
+		bool matchAddress(const unordered_set<int>& FDs, const unordered_set<int>& processesIDs) const {
+			return (FDs.empty() ||
+					FDs.contains(FD)) &&
+				   (processesIDs.empty() ||
+					processesIDs.contains(processID));
+		}
+
+		bool match(const unordered_set<int>& FDs, const unordered_set<int>& processesIDs, const unordered_set<string>& senderTokens, bool fallback = false) const {
+			return matchAddress(FDs, processesIDs) &&
+				   (Interface::tokensMatch(tokens, senderTokens) || fallback &&
+				    Interface::tokensMatch(senderTokens, tokens));
+		}
+	};
+
+	struct Client {
 		enum class State {
 			Pending,  // For spawned processes (if dashboard will ever able to have own child processes)
 			Connected,
 			Unresponsive
 		} state;
 		usize heartbeatTaskID = 0;
-		unordered_set<string> tokens;
 		unordered_map<string, Request> requests;
+	};
 
-		bool match(const unordered_set<int>& FDs, const unordered_set<int>& processesIDs, const unordered_set<string>& senderTokens, bool fallback = false) {
-			return (FDs.empty() ||
-					FDs.contains(FD)) &&
-				   (processesIDs.empty() ||
-					processesIDs.contains(processID)) &&
-				   (Interface::tokensMatch(tokens, senderTokens) || fallback &&
-				    Interface::tokensMatch(senderTokens, tokens));
+	/**
+	 * Clients by undirected tokens they receive (input) and send (output) with, so recipients
+	 * are looked up by tokens of a sender instead of matching tokens of every client.
+	 */
+	struct TokensIndex {
+		unordered_map<string, unordered_set<int>> inputs,
+												  outputs;
+
+		void add(int FD, const unordered_set<string>& tokens) {
+			for(const string& token : tokens) {
+				if(Interface::isInputToken(token)) {
+					inputs[token.substr(1)].insert(FD);
+				}
+				if(Interface::isOutputToken(token)) {
+					outputs[token.substr(1)].insert(FD);
+				}
+			}
+		}
+
+		void remove(int FD, const unordered_set<string>& tokens) {
+			auto erase = [&](unordered_map<string, unordered_set<int>>& index, const string& token) {
+				auto it = index.find(token.substr(1));
+
+				if(it != index.end() && it->second.erase(FD) && it->second.empty()) {
+					index.erase(it);
+				}
+			};
+
+			for(const string& token : tokens) {
+				if(Interface::isInputToken(token)) {
+					erase(inputs, token);
+				}
+				if(Interface::isOutputToken(token)) {
+					erase(outputs, token);
+				}
+			}
+		}
+
+		/**
+		 * Same as Route::match by tokens: receivers' input tokens against sender's output tokens,
+		 * with fallback also receivers' output tokens against sender's input tokens.
+		 */
+		unordered_set<int> match(const unordered_set<string>& senderTokens, bool fallback = false) const {
+			unordered_set<int> FDs;
+
+			auto merge = [&](const unordered_map<string, unordered_set<int>>& index, const string& token) {
+				auto it = index.find(token.substr(1));
+
+				if(it != index.end()) {
+					FDs.insert(it->second.begin(), it->second.end());
+				}
+			};
+
+			for(const string& token : senderTokens) {
+				if(Interface::isOutputToken(token)) {
+					merge(inputs, token);
+				}
+				if(fallback && Interface::isInputToken(token)) {
+					merge(outputs, token);
+				}
+			}
+
+			return FDs;
+		}
+	};
+
+	/**
+	 * Snapshot of routes that is replaced as a whole when clients connect, disconnect or change tokens,
+	 * so messages are routed without locks and never wait for the state of other clients.
+	 */
+	struct Routes {
+		unordered_map<int, Route> routes;
+		TokensIndex tokensIndex;
+		Interface::Subscriptions subscriptions = {};  // Highest over all routes
+
+		const Route* find(int FD) const {
+			auto it = routes.find(FD);
+
+			return it != routes.end() ? &it->second : nullptr;
+		}
+
+		vector<int> match(int senderFD, const unordered_set<int>& FDs, const unordered_set<int>& processesIDs, const unordered_set<string>& senderTokens, bool fallback = false) const {
+			vector<int> clientsFDs;
+
+			for(int clientFD : tokensIndex.match(senderTokens, fallback)) {
+				if(clientFD != senderFD && routes.at(clientFD).matchAddress(FDs, processesIDs)) {
+					clientsFDs.push_back(clientFD);
+				}
+			}
+
+			return clientsFDs;
 		}
 	};
 
-	unordered_map<int, Client> clients;
-	mutex clientsMutex;
+	atomic<sp<const Routes>> currentRoutes = SP<const Routes>();
+	mutex routesMutex,  // Serializes updates only
+		  announcementsMutex;  // Orders subscriptions announcements, which are sent after updates are published
+
+	/**
+	 * Announcements are sent after routes are published and unlocked, so a slow client can't hold back updates.
+	 * An announcement superseded by a change of subscriptions is skipped, as that change is announced to everyone.
+	 */
+	void announceSubscriptions(const sp<const Routes>& previousRoutes, const sp<const Routes>& routes) {
+		lock_guard lock(announcementsMutex);
+
+		if(currentRoutes.load()->subscriptions != routes->subscriptions) {
+			return;
+		}
+
+		bool changed = routes->subscriptions != previousRoutes->subscriptions;
+		sp<const string> announcement;
+
+		for(auto& [FD, route] : routes->routes) {
+			const Route* previousRoute = previousRoutes->find(FD);
+
+			if(!route.declaresSubscriptions || (!changed && previousRoute && previousRoute->declaresSubscriptions)) {
+				continue;
+			}
+			if(!announcement) {
+				announcement = SP<const string>(to_string(Node {
+					{"type", "notification"},
+					{"source", "server"},
+					{"action", "subscriptions"},
+					{"subscriptions", Interface::subscriptionsNode(routes->subscriptions)}
+				}));
+			}
+
+			sharedServer->send(FD, announcement);  // In JSON, as producers may not have negotiated binary yet
+		}
+	}
+
+	/**
+	 * Producers of notifications are announced what the clients are subscribed to, whenever it changes
+	 * and when they start to declare own subscriptions.
+	 */
+	void updateRoutes(const function<void(Routes&)>& update) {
+		sp<const Routes> previousRoutes;
+		sp<Routes> routes;
+
+		{
+			lock_guard lock(routesMutex);
+
+			previousRoutes = currentRoutes.load();
+			routes = SP<Routes>(*previousRoutes);
+
+			update(*routes);
+
+			routes->subscriptions = {};
+
+			for(auto& [FD, route] : routes->routes) {
+				for(usize i = 0; i < route.subscriptions.size(); i++) {
+					routes->subscriptions[i] = max(routes->subscriptions[i], route.subscriptions[i]);
+				}
+			}
+
+			currentRoutes = routes;
+		}
+
+		announceSubscriptions(previousRoutes, routes);
+	}
+
+	/**
+	 * Mutable state of clients (heartbeats, requests) is sharded by FD, so unrelated clients don't contend.
+	 * Locks are held only while the state is changed, never while parsing, logging or sending.
+	 */
+	struct ClientsShard {
+		std::mutex mutex;
+		unordered_map<int, Client> clients;
+	};
+
+	array<ClientsShard, 16> clientsShards;
+
+	ClientsShard& shardOf(int FD) {
+		return clientsShards[FD%clientsShards.size()];
+	}
 
 	// ----------------------------------------------------------------
 
-	optional<usize> scheduleRequestTimeout(int senderFD, string requestID, int timeout) {
+	Scheduler::Handle scheduleRequestTimeout(int senderFD, string requestID, int timeout) {
 		if(timeout <= 0) {
-			return nullopt;
+			return nullptr;
 		}
 
-		return sharedScheduler.schedule([senderFD, requestID](usize timeoutTaskID) {
-			lock_guard lock(clientsMutex);
+		Scheduler::Handle completion;
 
-			if(Client* client = find_ptr(clients, senderFD)) {
-				auto it = client->requests.find(requestID);
+		sharedScheduler.schedule([senderFD, requestID](usize) {
+			bool unanswered = false;
 
-				if(it != client->requests.end()) {
-					if(!some(it->second.responderFDs, [](auto& v) { return v.second; })) {
-						println(sharedServer->getLogPrefix(), "Request \"", requestID, "\" from ", senderFD, " has timed out with no response");
-					}
+			{
+				ClientsShard& shard = shardOf(senderFD);
+				lock_guard lock(shard.mutex);
+
+				if(Client* client = find_ptr(shard.clients, senderFD)) {
+					auto it = client->requests.find(requestID);
 
-					client->requests.erase(it);
+					if(it != client->requests.end()) {
+						unanswered = !some(it->second.responderFDs, [](auto& v) { return v.second; });
+
+						client->requests.erase(it);
+					}
 				}
 			}
 
-			sharedScheduler.cancel(timeoutTaskID);
-		}, timeout*1000);
+			if(unanswered) {
+				println(sharedServer->getLogPrefix(), "Request \"", requestID, "\" from ", senderFD, " has timed out with no response");
+			}
+		}, timeout*1000, false, false, &completion);
+
+		return completion;
+	}
+
+	/**
+	 * Unregisters a request, so its timeout doesn't stay scheduled until it fires.
+	 */
+	void removeRequest(Client& client, unordered_map<string, Request>::iterator it) {
+		if(it->second.timeoutCompletion) {
+			it->second.timeoutCompletion->cancel();
+		}
+
+		client.requests.erase(it);
 	}
 
 	usize scheduleServerHeartbeat(int clientFD) {
-		return sharedScheduler.schedule([clientFD](int taskID) {
-			unique_lock lock(clientsMutex);
+		return sharedScheduler.schedule([clientFD](usize taskID) {
+			ClientsShard& shard = shardOf(clientFD);
+			unique_lock lock(shard.mutex);
+			Client* client = find_ptr(shard.clients, clientFD);
 
-			if(!sharedServer->isRunning() || !clients.contains(clientFD)) {
+			if(!sharedServer->isRunning() || !client) {
 				sharedScheduler.cancel(taskID);
+
+				return;
 			}
 
-			switch(clients[clientFD].state) {
+			switch(client->state) {
 				case Client::State::Connected:
-					clients[clientFD].state = Client::State::Unresponsive;
+					client->state = Client::State::Unresponsive;
+					lock.unlock();
 					println(sharedServer->getLogPrefix(), "Cautiously awaiting heartbeat from ", clientFD);
 				break;
 				case Client::State::Unresponsive:
 					lock.unlock();
 					sharedServer->disconnect(clientFD);
 				break;
+				case Client::State::Pending:  // Not connected yet, so not expected to send heartbeats
+				break;
 			}
 		}, 15000, true);
 	}
 
 	usize scheduleClientHeartbeat() {
-		return sharedScheduler.schedule([](int taskID) {
+		return sharedScheduler.schedule([](usize taskID) {
 			if(!sharedClient->isRunning()) {
 				sharedScheduler.cancel(taskID);
 			}
@@ -101,7 +313,9 @@ namespace RootServer {
 			Interface::sendToServer({
 				{"type", "notification"},
 				{"action", "heartbeat"},
-				{"senderTokens", senderTokens}
+				{"senderTokens", senderTokens},
+				{"encodings", NodeArray { "binary" }},  // JSON is always supported
+				{"subscriptions", Interface::subscriptionsNode({})}  // Produces notifications, doesn't consume them
 			});
 		}, 7500, true, true);
 	}
@@ -109,188 +323,315 @@ namespace RootServer {
 	// ----------------------------------------------------------------
 
 	void handleServerConnect(int clientFD) {
-		lock_guard lock(clientsMutex);
-		ucred credentials;
+		ucred credentials = {};
 		socklen_t len = sizeof(ucred);
 
 		if(getsockopt(clientFD, SOL_SOCKET, SO_PEERCRED, &credentials, &len) < 0) {
 			println(sharedServer->getLogPrefix(), "Can't get credentials of ", clientFD);
 		}
 
-		clients[clientFD] = {
-			.FD = clientFD,
-			.processID = credentials.pid,
-			.state = Client::State::Connected,
-			.heartbeatTaskID = scheduleServerHeartbeat(clientFD)
-		};
+		{
+			ClientsShard& shard = shardOf(clientFD);
+			lock_guard lock(shard.mutex);
+
+			shard.clients[clientFD] = {
+				.state = Client::State::Connected,
+				.heartbeatTaskID = scheduleServerHeartbeat(clientFD),
+				.requests = {}
+			};
+		}
+
+		updateRoutes([&](Routes& routes) {
+			routes.routes[clientFD] = {
+				.FD = clientFD,
+				.processID = credentials.pid,
+				.tokens = {}
+			};
+		});
 	}
 
 	void handleServerDisconnect(int clientFD) {
-		lock_guard lock(clientsMutex);
-		Client& client = clients.at(clientFD);
+		{
+			ClientsShard& shard = shardOf(clientFD);
+			lock_guard lock(shard.mutex);
 
-		sharedScheduler.cancel(client.heartbeatTaskID);
+			if(Client* client = find_ptr(shard.clients, clientFD)) {
+				sharedScheduler.cancel(client->heartbeatTaskID);
 
-		for(auto& [requestID, request] : client.requests) {
-			if(request.timeoutTaskID) {
-				sharedScheduler.cancel(*request.timeoutTaskID);
+				for(auto& [requestID, request] : client->requests) {
+					if(request.timeoutCompletion) {
+						request.timeoutCompletion->cancel();
+					}
+				}
+
+				shard.clients.erase(clientFD);
 			}
 		}
 
-		clients.erase(clientFD);
+		updateRoutes([&](Routes& routes) {
+			if(const Route* route = routes.find(clientFD)) {
+				routes.tokensIndex.remove(clientFD, route->tokens);
+				routes.routes.erase(clientFD);
+			}
+		});
 	}
 
-	void handleServerMessage(int senderFD, const string& rawMessage) {
-		lock_guard lock(clientsMutex);
-		Client& sender = clients.at(senderFD);
+	/**
+	 * Fields that messages are routed by, the only ones parsed or decoded. The rest is copied as is.
+	 */
+	const unordered_set<string_view> routedKeys = {
+		"receiver", "type", "action",
+		"requestID", "responseID", "timeout", "reauthReceiver", "multipleResponses",
+		"receiverFDs", "receiverProcessesIDs", "receiverTokens",
+		"senderTokens", "encodings", "subscriptions", "source"
+	};
+
+	/**
+	 * Messages of one sender are handled sequentially, but different senders are handled concurrently.
+	 */
+	void handleServerMessage(int senderFD, string_view rawMessage) {
+		bool binary = NodeBinary::is(rawMessage);
+		optional<NodeView> view;
+		NodeSP message;
+
+		if(binary) {
+			message = NodeBinary::decode(rawMessage, routedKeys);
+		} else {
+			message = view.emplace(rawMessage).parse(routedKeys);
+		}
 
-		if(NodeSP message = NodeParser(rawMessage).parse()) {
-			string receiver = message->get("receiver"),
-				   type = message->get("type");
+		sp<const Routes> routes = currentRoutes.load();
+		const Route* sender = routes->find(senderFD);
 
-			if(receiver == "server") {
-				#ifndef NDEBUG
-					println(sharedServer->getLogPrefix(), "Handling server-side message from ", senderFD, ": ", rawMessage);
-				#endif
+		if(!message || !sender) {
+			return;
+		}
 
-				string action = message->get("action");
+		auto readableMessage = [&]() -> string {
+			return binary ? NodeBinary::toJSON(rawMessage).value_or("(malformed binary message)") : string(rawMessage);
+		};
 
-				if(type == "notification") {
-					if(action == "heartbeat") {
-						sharedScheduler.reset(sender.heartbeatTaskID);
+		string receiver = message->get("receiver"),
+			   type = message->get("type");
 
-						if(sender.state == Client::State::Unresponsive) {
-							sender.state = Client::State::Connected;
-							println(sharedServer->getLogPrefix(), "Late heartbeat from ", senderFD);
-						} else {
-							#ifndef NDEBUG
-								println(sharedServer->getLogPrefix(), "Heartbeat from ", senderFD);
-							#endif
-						}
+		if(receiver == "server") {
+			#ifndef NDEBUG
+				println(sharedServer->getLogPrefix(), "Handling server-side message from ", senderFD, ": ", readableMessage());
+			#endif
 
-						// TODO: Replace with explicit registration (tokens should be opaque most of the time and only owned by a server)
-						if(NodeArraySP senderTokens = message->get("senderTokens")) {
-							sender.tokens = {};
+			string action = message->get("action");
 
-							for(string t : *senderTokens) {
-								if(Interface::isToken(t)) {
-									sender.tokens.insert(t);
-								}
-							}
+			if(type == "notification") {
+				if(action == "heartbeat") {
+					bool late = false;
 
-							#ifndef NDEBUG
-								println(sharedServer->getLogPrefix(), "Tokens set for ", senderFD, ": ", join(sender.tokens, ", "));
-							#endif
+					{
+						ClientsShard& shard = shardOf(senderFD);
+						lock_guard lock(shard.mutex);
+
+						if(Client* client = find_ptr(shard.clients, senderFD)) {
+							sharedScheduler.reset(client->heartbeatTaskID);
+
+							late = client->state == Client::State::Unresponsive;
+							client->state = Client::State::Connected;
 						}
-					} else
-					if(action == "cancelRequest") {
-						string requestID = message->get("requestID");
+					}
 
-						sender.requests.erase(requestID);  // Unregister pending request
+					if(late) {
+						println(sharedServer->getLogPrefix(), "Late heartbeat from ", senderFD);
 					} else {
-						println(sharedServer->getLogPrefix(), "Unknown server-side notification action from ", senderFD, ": \"", action, "\"");
+						#ifndef NDEBUG
+							println(sharedServer->getLogPrefix(), "Heartbeat from ", senderFD);
+						#endif
 					}
-				} else
-				if(type == "request") {
-					string requestID = message->get("requestID");
 
-					if(action == "listClients") {
-						auto clientsFDs = clients | views::keys;
+					// TODO: Replace with explicit registration (tokens should be opaque most of the time and only owned by a server)
+					unordered_set<string> tokens = sender->tokens;
+					bool binaryEncoding = false;
+					Interface::Subscriptions subscriptions = Interface::allSubscriptions;
+					NodeSP declaredSubscriptions = message->get("subscriptions", nullptr);
+
+					if(NodeArraySP senderTokens = message->get("senderTokens")) {
+						tokens = {};
 
-						sharedServer->send(senderFD, Node {
-							{"type", "response"},
-							{"responseID", requestID},
-							{"clientsFDs", NodeArray(clientsFDs.begin(), clientsFDs.end())},
-							{"receiverFD", senderFD}
+						for(string t : *senderTokens) {
+							if(Interface::isToken(t)) {
+								tokens.insert(t);
+							}
+						}
+
+						#ifndef NDEBUG
+							println(sharedServer->getLogPrefix(), "Tokens set for ", senderFD, ": ", join(tokens, ", "));
+						#endif
+					}
+					if(NodeArraySP encodings = message->get("encodings", nullptr)) {
+						binaryEncoding = some(*encodings, [](const NodeValue& v) { return v == "binary"; });
+					}
+					if(declaredSubscriptions) {
+						subscriptions = Interface::parseSubscriptions(*declaredSubscriptions);
+					}
+
+					if(
+						tokens != sender->tokens ||
+						binaryEncoding != sender->binaryEncoding ||
+						subscriptions != sender->subscriptions ||
+						bool(declaredSubscriptions) != sender->declaresSubscriptions
+					) {  // Routes are replaced only on changes, heartbeats are frequent
+						updateRoutes([&](Routes& routes) {
+							if(Route* route = find_ptr(routes.routes, senderFD)) {
+								routes.tokensIndex.remove(senderFD, route->tokens);
+								route->tokens = tokens;
+								route->binaryEncoding = binaryEncoding;
+								route->subscriptions = subscriptions;
+								route->declaresSubscriptions = bool(declaredSubscriptions);
+								routes.tokensIndex.add(senderFD, route->tokens);
+							}
+						});
+					}
+					if(binaryEncoding && !sender->binaryEncoding) {
+						sharedServer->send(senderFD, Node {  // Acknowledged in JSON, as the client starts sending binary only after that
+							{"type", "notification"},
+							{"source", "server"},
+							{"action", "encoding"},
+							{"encoding", "binary"}
 						});
-					} else {
-						println(sharedServer->getLogPrefix(), "Unknown server-side request action from ", senderFD, ": \"", action, "\"");
+					}
+				} else
+				if(action == "cancelRequest") {
+					string requestID = message->get("requestID");
+					ClientsShard& shard = shardOf(senderFD);
+					lock_guard lock(shard.mutex);
+
+					if(Client* client = find_ptr(shard.clients, senderFD)) {
+						if(auto it = client->requests.find(requestID); it != client->requests.end()) {
+							removeRequest(*client, it);  // Unregister pending request
+						}
 					}
 				} else {
-					println(sharedServer->getLogPrefix(), "Unknown server-side message type from ", senderFD, ": \"", type, "\"");
+					println(sharedServer->getLogPrefix(), "Unknown server-side notification action from ", senderFD, ": \"", action, "\"");
 				}
 			} else
-			if(receiver == "client") {
-				#ifndef NDEBUG
-					println(sharedServer->getLogPrefix(), "Handling client-side message from ", senderFD, ": ", rawMessage);
-				#endif
+			if(type == "request") {
+				string requestID = message->get("requestID");
 
-				unordered_set<int> receiverFDs,
-								   receiverProcessesIDs;
-				unordered_set<string> senderTokens;
-				int sends = 0;
+				if(action == "listClients") {
+					auto clientsFDs = routes->routes | views::keys;
 
-				message->remove("receiver");
+					sharedServer->send(senderFD, Node {
+						{"type", "response"},
+						{"responseID", requestID},
+						{"clientsFDs", NodeArray(clientsFDs.begin(), clientsFDs.end())},
+						{"receiverFD", senderFD}
+					});
+				} else {
+					println(sharedServer->getLogPrefix(), "Unknown server-side request action from ", senderFD, ": \"", action, "\"");
+				}
+			} else {
+				println(sharedServer->getLogPrefix(), "Unknown server-side message type from ", senderFD, ": \"", type, "\"");
+			}
+		} else
+		if(receiver == "client") {
+			#ifndef NDEBUG
+				println(sharedServer->getLogPrefix(), "Handling client-side message from ", senderFD, ": ", readableMessage());
+			#endif
+
+			unordered_set<int> receiverFDs,
+							   receiverProcessesIDs;
+			unordered_set<string> senderTokens;
+			vector<int> receiversFDs;
+
+			if(NodeArraySP RFD = message->get("receiverFDs", nullptr)) {
+				receiverFDs = { RFD->begin(), RFD->end() };
+			}
+			if(NodeArraySP RPID = message->get("receiverProcessesIDs", nullptr)) {
+				receiverProcessesIDs = { RPID->begin(), RPID->end() };
+			}
+			if(NodeArraySP RT = message->get("receiverTokens", nullptr)) {
+				for(const NodeValue& receiverToken : *RT) {
+					senderTokens.insert(">"+string(receiverToken));
+				}
+			} else {
+				senderTokens = sender->tokens;
+			}
 
-				if(NodeArraySP RFD = message->get("receiverFDs", nullptr)) {
-									 message->remove("receiverFDs");
+			// Body of the message is never parsed, routing fields are removed and sender is added to the original bytes
+			unordered_set<string_view> removedKeys = {"receiver", "receiverFDs", "receiverProcessesIDs", "receiverTokens"};
+			Node addedFields = {
+				{"senderFD", senderFD},
+				{"senderProcessID", sender->processID}
+			};
+			optional<string> splicedMessage = binary ? NodeBinary::splice(rawMessage, removedKeys, addedFields) : view->splice(removedKeys, addedFields);
 
-					receiverFDs = { RFD->begin(), RFD->end() };
-				}
-				if(NodeArraySP RPID = message->get("receiverProcessesIDs", nullptr)) {
-									  message->remove("receiverProcessesIDs");
+			if(!splicedMessage) {
+				return;
+			}
 
-					receiverProcessesIDs = { RPID->begin(), RPID->end() };
-				}
-				if(NodeArraySP RT = message->get("receiverTokens", nullptr)) {
-									message->remove("receiverTokens");
+			auto dryMessage = SP<const string>(move(*splicedMessage));  // Shared by all recipients
 
-					for(const string& receiverToken : *RT) {
-						senderTokens.insert(">"+receiverToken);
-					}
-				} else {
-					senderTokens = sender.tokens;
-				}
+			if(type == "notification") {
+				string source = message->get<string>("source");
+				auto it = find(Interface::sourcesNames.begin(), Interface::sourcesNames.end(), source);
 
-				(*message)["senderFD"] = senderFD;
-				(*message)["senderProcessID"] = sender.processID;
+				receiversFDs = routes->match(senderFD, receiverFDs, receiverProcessesIDs, senderTokens, true);  // Notify
 
-				string dryMessage = *message;
+				if(it != Interface::sourcesNames.end()) {
+					erase_if(receiversFDs, [&](int receiverFD) {  // Unsubscribed, notifications may be produced for others
+						return routes->find(receiverFD)->subscriptions[it-Interface::sourcesNames.begin()] == Interface::Detail::None;
+					});
+				}
+			} else
+			if(type == "request") {
+				string requestID = message->get("requestID");
+				int timeout = message->contains("timeout") ? message->get<int>("timeout") : 30;
+				bool reauthReceiver = message->get("reauthReceiver"),
+					 multipleResponses = message->get("multipleResponses"),
+					 duplicate = false;
 
-				if(type == "notification") {
-					for(auto& [clientFD, client] : clients) {
-						if(clientFD != senderFD && client.match(receiverFDs, receiverProcessesIDs, senderTokens, true)) {
-							sharedServer->send(clientFD, dryMessage);  // Notify
-							sends++;
-						}
-					}
-				} else
-				if(type == "request") {
-					string requestID = message->get("requestID");
+				receiversFDs = routes->match(senderFD, receiverFDs, receiverProcessesIDs, senderTokens);  // Request responce
 
-					if(sender.requests.contains(requestID)) {
-						println(sharedServer->getLogPrefix(), "Request \"", requestID, "\" is already created by ", senderFD, " and will not be replaced");
+				{
+					ClientsShard& shard = shardOf(senderFD);
+					lock_guard lock(shard.mutex);
+					Client* client = find_ptr(shard.clients, senderFD);
 
+					if(!client) {
 						return;
 					}
 
-					int timeout = message->contains("timeout") ? message->get<int>("timeout") : 30;
-					bool reauthReceiver = message->get("reauthReceiver"),
-						 multipleResponses = message->get("multipleResponses");
-					Request& request = (sender.requests[requestID] = {  // Register request
-						senderTokens,
-						receiverFDs,
-						receiverProcessesIDs,
-						timeout,
-						scheduleRequestTimeout(senderFD, requestID, timeout),
-						reauthReceiver,
-						multipleResponses
-					});
+					duplicate = client->requests.contains(requestID);
+
+					if(!duplicate) {
+						Request& request = (client->requests[requestID] = {  // Register request
+							senderTokens,
+							receiverFDs,
+							receiverProcessesIDs,
+							timeout,
+							scheduleRequestTimeout(senderFD, requestID, timeout),
+							reauthReceiver,
+							multipleResponses,
+							{}
+						});
 
-					for(auto& [clientFD, client] : clients) {
-						if(clientFD != senderFD && client.match(receiverFDs, receiverProcessesIDs, senderTokens)) {
-							request.responderFDs[clientFD] = false;  // Register responder
+						for(int responderFD : receiversFDs) {
+							request.responderFDs[responderFD] = false;  // Register responder
 						}
 					}
-					for(auto& [responderFD, responded] : request.responderFDs) {
-						sharedServer->send(responderFD, dryMessage);  // Request responce
-						sends++;
-					}
-				} else
-				if(type == "response") {
-					string responseID = message->get("responseID");
+				}
+
+				if(duplicate) {
+					println(sharedServer->getLogPrefix(), "Request \"", requestID, "\" is already created by ", senderFD, " and will not be replaced");
+
+					return;
+				}
+			} else
+			if(type == "response") {
+				string responseID = message->get("responseID");
+				bool reauthFailed = false;
 
-					for(auto& [clientFD, client] : clients) {
+				for(ClientsShard& shard : clientsShards) {
+					lock_guard lock(shard.mutex);
+
+					for(auto& [clientFD, client] : shard.clients) {
 						auto it = client.requests.find(responseID);
 
 						if(it == client.requests.end()) {
@@ -302,35 +643,64 @@ namespace RootServer {
 						if(!request.responderFDs.contains(senderFD)) {
 							continue;  // Allow only previously registered responders to handle request with that ID
 						}
-						if(request.reauthReceiver && !sender.match(request.receiverFDs, request.receiverProcessesIDs, request.receiverTokens)) {
-							println(sharedServer->getLogPrefix(), "Responder ", senderFD, " has failed to reauthentificate");
+						if(request.reauthReceiver && !sender->match(request.receiverFDs, request.receiverProcessesIDs, request.receiverTokens)) {
+							reauthFailed = true;
 
 							continue;
 						}
 
-						sharedServer->send(clientFD, dryMessage);  // Respond
-						sends++;
+						receiversFDs.push_back(clientFD);  // Respond
 						request.responderFDs.at(senderFD) = true;
 
 						if(!request.multipleResponses || !some(request.responderFDs, [](auto& v) { return !v.second; })) {
-							client.requests.erase(it);  // Unregister fulfilled request
+							removeRequest(client, it);  // Unregister fulfilled request
 						}
 					}
-				} else {
-					println(sharedServer->getLogPrefix(), "Unknown client-side message type from ", senderFD, ": \"", type, "\"");
 				}
 
-				if(sends == 0) {
-					println(sharedServer->getLogPrefix(), "No message was sent to clients while handling: ", rawMessage);
+				if(reauthFailed) {
+					println(sharedServer->getLogPrefix(), "Responder ", senderFD, " has failed to reauthentificate");
 				}
 			} else {
-				println(sharedServer->getLogPrefix(), "Unknown receiver kind from ", senderFD, ": \"", receiver, "\"");
+				println(sharedServer->getLogPrefix(), "Unknown client-side message type from ", senderFD, ": \"", type, "\"");
+			}
+
+			if(receiversFDs.empty()) {
+				println(sharedServer->getLogPrefix(), "No message was sent to clients while handling: ", readableMessage());
+
+				return;
 			}
+
+			if(binary) {
+				vector<int> JSONReceiversFDs;
+
+				erase_if(receiversFDs, [&](int receiverFD) {
+					const Route* route = routes->find(receiverFD);
+
+					if(route && route->binaryEncoding) {
+						return false;
+					}
+
+					JSONReceiversFDs.push_back(receiverFD);
+
+					return true;
+				});
+
+				if(!JSONReceiversFDs.empty()) {
+					if(optional<string> JSONMessage = NodeBinary::toJSON(*dryMessage)) {  // Transcoded once for all clients that haven't negotiated binary
+						sharedServer->send(JSONReceiversFDs, SP<const string>(move(*JSONMessage)));
+					}
+				}
+			}
+
+			sharedServer->send(receiversFDs, dryMessage);
+		} else {
+			println(sharedServer->getLogPrefix(), "Unknown receiver kind from ", senderFD, ": \"", receiver, "\"");
 		}
 	}
 
 	void startServer() {
-		sharedServer = SP<Socket>(*Interface::preferences.socketPath, Socket::Mode::Server);
+		sharedServer = SP<Socket>(*Interface::preferences.socketPath, Socket::Mode::Server, Interface::preferences.socketThreadsCount);
 
 		sharedServer->setConnectionHandler(&handleServerConnect, &handleServerDisconnect);
 		sharedServer->setMessageHandler(&handleServerMessage);
@@ -340,7 +710,17 @@ namespace RootServer {
 
 	// ----------------------------------------------------------------
 
-	int clientHeartbeatTaskID = -1;
+	usize clientHeartbeatTaskID = 0;
+
+	/**
+	 * Messages from the server are handled in order on a thread of their own, as interpretation may take long,
+	 * while the client's reactor should keep flushing sent messages (heartbeats included) meanwhile.
+	 */
+	struct ClientInbox {
+		std::mutex mutex;
+		condition_variable condition;
+		deque<pair<int, string>> messages;  // [FD : Message]
+	} clientInbox;
 
 	void handleClientConnect(int) {
 		clientHeartbeatTaskID = scheduleClientHeartbeat();
@@ -348,10 +728,19 @@ namespace RootServer {
 
 	void handleClientDisconnect(int) {
 		sharedScheduler.cancel(clientHeartbeatTaskID);
+
+		{
+			lock_guard lock(clientInbox.mutex);
+
+			clientInbox.messages.clear();  // Meant for the previous connection
+		}
+
+		Interface::binaryEncoding = false;  // Renegotiated by the next connection
+		Interface::setSubscriptions(Interface::allSubscriptions);
 	}
 
-	void handleClientMessage(int, const string& rawMessage) {
-		NodeSP message = NodeParser(rawMessage).parse();
+	void handleClientMessage(int, string_view rawMessage) {
+		NodeSP message = Interface::parse(rawMessage);
 
 		if(!message) {
 			return;
@@ -361,25 +750,32 @@ namespace RootServer {
 			   action = message->get("action");
 
 		if(type == "notification") {
+			if(action == "encoding") {
+				Interface::binaryEncoding = message->get<string>("encoding") == "binary";
+			} else
+			if(action == "subscriptions") {
+				if(NodeSP subscriptions = message->get("subscriptions", nullptr)) {
+					Interface::setSubscriptions(Interface::parseSubscriptions(*subscriptions));
+				}
+			} else
 			if(action == "lex") {
 				lock_guard lock(interpreterMutex);
 
-				code = message->get<string>("code");
-				tokens = Lexer(*code).tokenize();
+				artifact = sharedArtifacts.lex(SP<SourceBuffer>(message->get<string>("code")));
 			} else
 			if(action == "parse") {
 				lock_guard lock(interpreterMutex);
 
-				if(tokens) {
-					tree = Parser(*tokens).parse();
+				if(artifact) {
+					artifact = sharedArtifacts.parse(artifact);
 				}
 			} else
 			if(action == "interpret") {
 				lock_guard lock(interpreterMutex);
 
-				if(code && tokens && tree) {
+				if(artifact && artifact->tree) {
 					sharedInterpreter->clean();
-					SP<Interpreter>(sharedInterpreter, Interpreter::InheritedContext(2, 2, 2, 2), *code, *tokens, *tree)->interpret();
+					SP<Interpreter>(sharedInterpreter, Interpreter::InheritedContext(2, 2, 2, 2), artifact->code, artifact->tokens, artifact->tree)->interpret();
 				}
 			} else {
 				println(sharedClient->getLogPrefix(), "Unknown notification action: \"", action, "\"");
@@ -387,11 +783,9 @@ namespace RootServer {
 		} else
 		if(type == "request") {
 			if(action == "evaluate") {
-				string code = message->get("code");
-				auto tokens = Lexer(code).tokenize();
-				auto tree = Parser(tokens).parse();
+				ArtifactSP artifact = sharedArtifacts.get(SP<SourceBuffer>(message->get<string>("code")));
 
-				SP<Interpreter>(sharedInterpreter, Interpreter::InheritedContext(2), code, tokens, tree)->interpret();
+				SP<Interpreter>(sharedInterpreter, Interpreter::InheritedContext(2), artifact->code, artifact->tokens, artifact->tree)->interpret();
 			} else {
 				println(sharedClient->getLogPrefix(), "Unknown request action: \"", action, "\"");
 			}
@@ -400,11 +794,38 @@ namespace RootServer {
 		}
 	}
 
+	void receiveClientMessage(int FD, string_view rawMessage) {
+		lock_guard lock(clientInbox.mutex);
+
+		clientInbox.messages.emplace_back(FD, rawMessage);
+		clientInbox.condition.notify_one();
+	}
+
+	void handleClientMessages() {
+		prctl(PR_SET_NAME, "Client inbox", 0, 0, 0);
+
+		while(true) {
+			pair<int, string> message;
+
+			{
+				unique_lock lock(clientInbox.mutex);
+
+				clientInbox.condition.wait(lock, [] { return !clientInbox.messages.empty(); });
+				message = move(clientInbox.messages.front());
+				clientInbox.messages.pop_front();
+			}
+
+			handleClientMessage(message.first, message.second);
+		}
+	}
+
 	void startClient() {
 		sharedClient = SP<Socket>(*Interface::preferences.socketPath, Socket::Mode::Client);
 
 		sharedClient->setConnectionHandler(&handleClientConnect, &handleClientDisconnect);
-		sharedClient->setMessageHandler(&handleClientMessage);
+		sharedClient->setMessageHandler(&receiveClientMessage);
+
+		thread(&handleClientMessages).detach();
 
 		while(true) {
 			sharedClient->start();
@@ -420,6 +841,8 @@ int main(int argc, char* argv[]) {
 
 	Interface::printPreferences();
 
+	sharedThreadPool.start(Interface::preferences.threadPoolSize);
+
 	using namespace RootServer;
 
 	switch(Interface::preferences.mode) {
@@ -432,12 +855,20 @@ int main(int argc, char* argv[]) {
 			if(Interface::preferences.scriptPath) {
 				lock_guard lock(interpreterMutex);
 
-				if(optional<string> code = read_file(*Interface::preferences.scriptPath)) {
-					tokens = Lexer(*code).tokenize();
-					tree = Parser(*tokens).parse();
+				vector<Module> modules;
 
-					sharedInterpreter->clean();
-					SP<Interpreter>(sharedInterpreter, Interpreter::InheritedContext(2, 2, 2, 2), *code, *tokens, *tree)->interpret();
+				try {
+					modules = ModuleLoader().load(*Interface::preferences.scriptPath);
+				} catch(const exception& e) {
+					println("[ModuleLoader] Can't load ", *Interface::preferences.scriptPath, ": ", e.what());
+				}
+
+				sharedInterpreter->clean();
+
+				for(const Module& module : modules) {  // Dependencies first, in a shared context
+					artifact = module.artifact;
+
+					SP<Interpreter>(sharedInterpreter, Interpreter::InheritedContext(2, 2, 2, 2), artifact->code, artifact->tokens, artifact->tree)->interpret();
 				}
 			}
 			if(clientThread) {